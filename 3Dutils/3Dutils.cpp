@@ -12,6 +12,8 @@
 #include "..\common\OverwriteDlg\OverwriteDlg.h"
 #include "..\common\utils.h"
 #include "..\common\CSVParser.h"
+#include "..\common\CSVSource.h"
+#include "..\common\CSVColumns.h"
 #include "..\common\CSVWriter.h"
 
 #include "version.h"
@@ -19,8 +21,6 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
-#include <codecvt>
-
 #define V_ISDISPATCH(X)     (V_VT(X)&VT_DISPATCH)
 
 PALETTEENTRY DEFPALETTE[] = {
@@ -183,7 +183,6 @@ C3DutilsApp::C3DutilsApp()
 {
 	m_newKompasAPI = NULL;
 	m_kompas = NULL;
-	m_numlocale = _wcreate_locale(LC_NUMERIC, L"C");
 
 	m_selfilter = OM_BELONGSANY | OM_USECOLORMASK;
 	m_selcolorovr = FALSE;
@@ -201,7 +200,6 @@ C3DutilsApp::C3DutilsApp()
 
 C3DutilsApp::~C3DutilsApp()
 {
-	_free_locale(m_numlocale);
 }
 
 BOOL C3DutilsApp::InitInstance()
@@ -222,6 +220,7 @@ BOOL C3DutilsApp::ExitInstance()
 {
 	m_newKompasAPI = NULL;
 	m_kompas = NULL;
+	m_writer.shutdown(); // not from the destructor, that runs under the loader lock
 
 	return CWinApp::ExitInstance();
 }
@@ -633,8 +632,12 @@ BOOL C3DutilsApp::VariablesExport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 			ULONG done = 0;
 			CSVWriter csv(3); // name, value/expression, comment
 			CString vstr;
-			if (!vready) csv << L"" << L"" << L"";
-			for (ULONG index = 0; index < count; index++) {
+			// a list for a file goes to it as it is read, written on m_writer's thread
+			SetLastError(ERROR_SUCCESS);
+			BOOL opened = vready || clipbrd || csv.open(filename->lpstrFile, false, &m_writer);
+			DWORD openerr = GetLastError();
+			if (opened && !vready) csv << L"" << L"" << L"";
+			for (ULONG index = 0; opened && index < count; index++) {
 				ksAPI7::IVariable7Ptr var(pVars[index]);
 				if (var == NULL)
 					continue;
@@ -644,8 +647,10 @@ BOOL C3DutilsApp::VariablesExport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 					wcstod((LPCWSTR)var->Expression, &eptr);
 					if (*eptr != L'\0')
 						vstr.AppendFormat(L"%s%s=\"%s\"", done?L";":L"", (LPCWSTR)var->Name, (LPCWSTR)var->Expression);
-					else
-						vstr.AppendFormat(L"%s%s=%g", done?L";":L"", (LPCWSTR)var->Name, var->Value);
+					else {
+						vstr.AppendFormat(L"%s%s=", done?L";":L"", (LPCWSTR)var->Name);
+						Utils::AppendDouble(vstr, var->Value);
+					}
 				} else {
 					csv << (LPCWSTR)var->Name;
 					csv << (LPCWSTR)var->Expression;
@@ -658,24 +663,20 @@ BOOL C3DutilsApp::VariablesExport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 			if (V_ISARRAY(&vars) && pVars)
 				::SafeArrayUnaccessData( V_ARRAY(&vars) );
 
-			if (done > 0) {
+			if (done > 0 || !opened) {
 				CString str;
 				SetLastError(ERROR_SUCCESS);
-				if (vready) {
+				if (!opened) {
+					SetLastError(openerr);
+				} else if (vready) {
 					if (clipbrd) {
 						ret = Utils::Str2Clipboard((LPCWSTR)vstr);
 					} else {
-						std::wofstream file;
-
-						file.imbue(std::locale(file.getloc(), new std::codecvt_utf8<wchar_t, 0x10ffff, std::consume_header>));
-						file.open(filename->lpstrFile, std::ios::out);
-						if (file) {
-							file << (LPCWSTR)vstr << std::endl;
-							DWORD err = GetLastError();
-							if (file)
-								ret = TRUE;
-							file.close();
-							SetLastError(err);
+						UTF8FileWriter file;
+						if (file.open(filename->lpstrFile, false, false)) {
+							file.write((LPCWSTR)vstr, vstr.GetLength());
+							file.write(L"\r\n", 2);
+							ret = file.close();
 						}
 					}
 				} else {
@@ -683,7 +684,7 @@ BOOL C3DutilsApp::VariablesExport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 					if (clipbrd) {
 						ret = Utils::Str2Clipboard(csv.toString().c_str());
 					} else
-						ret = csv.writeToFile(filename->lpstrFile);
+						ret = csv.close(); // only the tail is left, the rows went to m_writer as they were read
 				}
 
 				if (ret) {
@@ -701,7 +702,8 @@ BOOL C3DutilsApp::VariablesExport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 					Utils::ComStrStatus(str, lret, TRUE);
 					MessageBox((HWND)GetHWindow(), (LPCWSTR)str, vready?L"  []":L"  []", MB_OK|MB_ICONERROR);
 				}
-			}
+			} else
+				csv.discard(); // nothing to export
 		}
 	}
 
@@ -713,7 +715,7 @@ BOOL C3DutilsApp::VariablesExport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 BOOL C3DutilsApp::VariablesImport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG embodiment )
 {
 	BOOL ret = FALSE;
-	std::wifstream csvstream;
+	aria::csv::FileSource csvfile;
 	CString report;
 
 	OPENFILENAME *filename = NULL;
@@ -724,10 +726,14 @@ BOOL C3DutilsApp::VariablesImport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 		return FALSE;
 	}
 
-	if ((lret = Utils::OpenCSVFile(csvstream, filename->lpstrFile)) == ERROR_SUCCESS) {
-		aria::csv::CsvParser *parser = new aria::csv::CsvParser(csvstream);
+	if ((lret = Utils::OpenCSVFile(csvfile, filename->lpstrFile)) == ERROR_SUCCESS) {
+		aria::csv::CsvParser *parser = new aria::csv::CsvParser(csvfile);
+		// Excel writes ';', ',' or tabs depending on the locale
 		parser->delimiter(L';');
-		LONG total = 0, done = 0, dstat = 0;
+		parser->sniff();
+		CString dialect;
+		Utils::CSVDialectString(dialect, csvfile, parser->delimiter());
+		LONG total = 0, done = 0, dstat = 0, skipped = 0;
 		UINT ovr = BST_INDETERMINATE;
 		CString discarded;
 		LPCWSTR reason = L"";
@@ -740,8 +746,11 @@ BOOL C3DutilsApp::VariablesImport( ksAPI7::IKompasDocument3DPtr & doc3d, LONG em
 			LPWSTR endptr = NULL;
 			ksAPI7::IVariable7Ptr var;
 
-			if ((fields < 2) || !Document::IsVariableNameValid(row[0].c_str())) // name, value/expression, comment
+			if ((fields < 2) || !Document::IsVariableNameValid(row[0].c_str())) { // name, value/expression, comment
+				if (fields > 0)
+					skipped++;
 				continue;
+			}
 
 			total++;
 
@@ -888,10 +897,15 @@ abort:
 				if (dstat > 0)
 					report.AppendFormat(L"...   %d", dstat);
 			}
+			if (skipped > 0)
+				report.AppendFormat(L"\n : %d (%s)", skipped, (LPCWSTR)dialect);
 			report += L"\n\n  (F5)   ";
 			MessageBox((HWND)GetHWindow(), (LPCWSTR)report, L" ", MB_OK|(ret ? MB_ICONINFORMATION : MB_ICONWARNING));
-		} else
-			MessageBox((HWND)GetHWindow(), L"       ", L" ", MB_OK|MB_ICONWARNING);
+		} else {
+			report.Format(L"        (%s),  : %d", (LPCWSTR)dialect, skipped);
+			MessageBox((HWND)GetHWindow(), (LPCWSTR)report, L" ", MB_OK|MB_ICONWARNING);
+		}
+		delete parser;
 	} else {
 		report.Format(L"   %: ", filename->lpstrFile);
 		Utils::ComStrStatus(report, lret, TRUE);
@@ -1116,6 +1130,18 @@ noapi:
 	return FALSE;
 }
 
+// Angles are plain numbers most of the time, anything
+// else is left to the expression calculator
+static BOOL TableAngle( const aria::csv::ColumnReader & table, SIZE_T col, SIZE_T row, double & angle )
+{
+	LPCWSTR expr = table.text(col, row);
+	if (expr == NULL) {
+		angle = table.number(col, row);
+		return TRUE;
+	}
+	return ksCalculateW(const_cast<LPWSTR>(expr), &angle);
+}
+
 UINT C3DutilsApp::LoadOrients()
 {
 	enum {
@@ -1127,8 +1153,7 @@ UINT C3DutilsApp::LoadOrients()
 	};
 	const SIZE_T bufsz = 32768;
 	LPWSTR mpath = NULL;
-	aria::csv::CsvParser *parser = NULL;
-	std::wifstream csvstream;
+	aria::csv::FileSource csvfile;
 
 	mpath = new WCHAR[bufsz];
 	if (mpath == NULL)
@@ -1142,35 +1167,46 @@ UINT C3DutilsApp::LoadOrients()
 
 	wcscpy_s(&mpath[nameidx], bufsz - nameidx, ORIENT_FILE);
 
-	if (Utils::OpenCSVFile(csvstream, mpath) != ERROR_SUCCESS)
+	if (Utils::OpenCSVFile(csvfile, mpath) != ERROR_SUCCESS) {
+		delete[] mpath;
 		return FALSE;
+	}
 
 	orient_t neworient;
-	parser = new aria::csv::CsvParser(csvstream);
-	parser->delimiter(L';');
+	aria::csv::CsvParser parser(csvfile);
+	parser.delimiter(L';');
+	aria::csv::ColumnReader table;
+	table.column(aria::csv::ColumnType::NUMBER)		// FIELD_ANGLEX
+		.column(aria::csv::ColumnType::NUMBER)		// FIELD_ANGLEY
+		.column(aria::csv::ColumnType::NUMBER)		// FIELD_ANGLEZ
+		.column(aria::csv::ColumnType::TEXT)		// FIELD_NAME
+		.column(aria::csv::ColumnType::TEXT);		// FIELD_TOOLTIP
+	table.read(parser);
+	delete[] mpath;
+
 	m_orients.clear();
 	int count = 0;
-	for (auto& row : *parser) {
+	for (SIZE_T row = 0; row < table.rows(); row++) {
 		if (count >= MAX_ORIENTS)
 			break;
 
-		SIZE_T fields = row.size();
+		SIZE_T fields = table.fields(row);
 		if (fields < 4)
 			continue;
 
-		if (wcslen(row[FIELD_NAME].c_str()) == 0)
+		if (wcslen(table.text(FIELD_NAME, row)) == 0)
 			continue;
 
 		SecureZeroMemory(&neworient, sizeof(neworient));
-		if (!ksCalculateW(const_cast<wchar_t*>(row[FIELD_ANGLEX].c_str()), &neworient.angleX))
+		if (!TableAngle(table, FIELD_ANGLEX, row, neworient.angleX))
 			continue;
-		if (!ksCalculateW(const_cast<wchar_t*>(row[FIELD_ANGLEY].c_str()), &neworient.angleY))
+		if (!TableAngle(table, FIELD_ANGLEY, row, neworient.angleY))
 			continue;
-		if (!ksCalculateW(const_cast<wchar_t*>(row[FIELD_ANGLEZ].c_str()), &neworient.angleZ))
+		if (!TableAngle(table, FIELD_ANGLEZ, row, neworient.angleZ))
 			continue;
-		wcsncpy(neworient.nameshort, row[FIELD_NAME].c_str(), _countof(neworient.nameshort) - 1);
+		wcsncpy(neworient.nameshort, table.text(FIELD_NAME, row), _countof(neworient.nameshort) - 1);
 		if (fields > 4)
-			wcsncpy(neworient.namefull, row[FIELD_TOOLTIP].c_str(), _countof(neworient.namefull) - 1);
+			wcsncpy(neworient.namefull, table.text(FIELD_TOOLTIP, row), _countof(neworient.namefull) - 1);
 
 		m_orients.push_back(neworient);
 		count++;
@@ -12,6 +12,7 @@
 
 #include "..\common\common.h"   // common stuff
 #include "..\common\document.h" // document stuff
+#include "..\common\AsyncWriter.h" // background file output
 #include "resource.h"           // main symbols
 
 #define DEFCOLOR RGB(144, 144, 144)
@@ -100,7 +101,7 @@ private:
 	// Members
 	ksAPI7::IApplicationPtr m_newKompasAPI;               
 	KompasObjectPtr m_kompas;
-	_locale_t m_numlocale;  // explicit numeric locale to stricten radix character
+	AsyncWriter m_writer;   // exports write on its thread while Kompas is read
 
 	// Selection params dialog
 	ULONG m_selfilter;
@@ -0,0 +1,166 @@
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Writes file buffers on a thread of its own, so whoever fills them can go
+// on while the disk (or a slow network share) catches up. Buffers are
+// written and files closed in the order they were queued. No more than
+// a few buffers wait at a time, a producer that gets that far ahead waits
+// for the writer. The thread starts with the first buffer and ends in
+// shutdown(), which must be called before the DLL is unloaded
+class AsyncWriter
+{
+    public:
+        // Called on the writer thread with the result of close()
+        typedef std::function<void(DWORD)> Callback;
+
+        AsyncWriter(size_t depth = 8){
+            this->depth = depth > 0 ? depth : 1;
+            this->stopping = false;
+        }
+
+        ~AsyncWriter(){
+            this->shutdown();
+        }
+
+        // Queues size bytes of buffer to be written to file. The buffer is
+        // taken over and an empty one of the same kind given back instead
+        void write(HANDLE file, std::vector<char>& buffer, size_t size){
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->start();
+            while (this->queue.size() >= this->depth)
+                this->changed.wait(lock);
+            this->queue.push_back(Job(file, size));
+            this->queue.back().data.swap(buffer);
+            if (!this->spare.empty()) {
+                buffer.swap(this->spare.back());
+                this->spare.pop_back();
+            }
+            this->changed.notify_all();
+        }
+
+        // Queues closing file after everything queued for it. The future
+        // and the callback get ERROR_SUCCESS or the first error of a write
+        // or of closing
+        std::future<DWORD> close(HANDLE file, Callback done = Callback()){
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->start();
+            while (this->queue.size() >= this->depth)
+                this->changed.wait(lock);
+            this->queue.push_back(Job(file, 0));
+            Job& job = this->queue.back();
+            job.close = true;
+            job.result = std::make_shared<std::promise<DWORD> >();
+            job.done = done;
+            std::future<DWORD> result = job.result->get_future();
+            this->changed.notify_all();
+            return result;
+        }
+
+        // Waits until everything queued so far has been done
+        void drain(){
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (!this->queue.empty())
+                this->changed.wait(lock);
+        }
+
+        // Does what is queued and ends the thread
+        void shutdown(){
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (!this->worker.joinable())
+                    return;
+                this->stopping = true;
+                this->changed.notify_all();
+            }
+            this->worker.join();
+            this->stopping = false;
+            std::vector<std::vector<char> >().swap(this->spare);
+        }
+    private:
+        struct Job {
+            HANDLE file;
+            size_t size;
+            bool close;
+            std::vector<char> data;
+            std::shared_ptr<std::promise<DWORD> > result;
+            Callback done;
+
+            Job(HANDLE file, size_t size){
+                this->file = file;
+                this->size = size;
+                this->close = false;
+            }
+        };
+
+        size_t depth;
+        bool stopping;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Job> queue;
+        std::vector<std::vector<char> > spare;
+        std::map<HANDLE, DWORD> errors;
+        std::thread worker;
+
+        AsyncWriter(const AsyncWriter&);
+        AsyncWriter& operator=(const AsyncWriter&);
+
+        // With the mutex held
+        void start(){
+            if (!this->worker.joinable())
+                this->worker = std::thread(&AsyncWriter::run, this);
+        }
+
+        void run(){
+            std::unique_lock<std::mutex> lock(this->mutex);
+            for (;;) {
+                while (this->queue.empty() && !this->stopping)
+                    this->changed.wait(lock);
+                if (this->queue.empty())
+                    return;
+
+                // The job stays queued until it is done, so drain() can tell
+                Job& job = this->queue.front();
+                DWORD error = this->errors[job.file];
+                lock.unlock();
+
+                if (!job.close) {
+                    DWORD written = 0;
+                    if (error == ERROR_SUCCESS &&
+                        (!WriteFile(job.file, &job.data[0], (DWORD)job.size, &written, NULL) || written != job.size)) {
+                        error = GetLastError();
+                        if (error == ERROR_SUCCESS)
+                            error = ERROR_WRITE_FAULT;
+                    }
+                } else {
+                    if (!CloseHandle(job.file) && error == ERROR_SUCCESS)
+                        error = GetLastError();
+                    job.result->set_value(error);
+                    if (job.done)
+                        job.done(error);
+                }
+
+                lock.lock();
+                if (job.close)
+                    this->errors.erase(job.file);
+                else
+                    this->errors[job.file] = error;
+                if (!job.data.empty() && this->spare.size() < this->depth) {
+                    this->spare.push_back(std::vector<char>());
+                    this->spare.back().swap(job.data);
+                }
+                this->queue.pop_front();
+                this->changed.notify_all();
+            }
+        }
+};
+
+#endif // ASYNCWRITER_H
@@ -0,0 +1,161 @@
+#ifndef ARIA_CSV_COLUMNS_H
+#define ARIA_CSV_COLUMNS_H
+
+#include <limits>
+#include <vector>
+
+#include "CSVParser.h"
+#include "numeric.h"
+
+namespace aria {
+  namespace csv {
+    enum class ColumnType { SKIP, TEXT, NUMBER };
+
+    // Reads a whole CSV into typed columns. Number columns become arrays of
+    // doubles, text goes into one arena of NUL terminated strings, so a table
+    // costs a few growing vectors instead of a string per cell. A number cell
+    // that does not parse (e.g. an expression) reads as NaN and keeps its text
+    class ColumnReader {
+    public:
+      // Declares the next column of the rows
+      ColumnReader& column(ColumnType type) {
+        m_columns.push_back(Column(type));
+        return *this;
+      }
+
+      // Expected number of rows, to allocate once
+      ColumnReader& reserve(size_t rows) {
+        m_fields.reserve(rows);
+        for (size_t i = 0; i < m_columns.size(); i++) {
+          m_columns[i].reserve(rows);
+        }
+        return *this;
+      }
+
+      // Reads the rest of the parser. Fields past the declared columns
+      // are ignored, missing ones read as NaN or empty text
+      size_t read(CsvParser& parser) {
+        if (m_arena.empty()) {
+          m_arena.push_back(L'\0');
+        }
+        size_t col = 0;
+        for (;;) {
+          FieldView field = parser.next_field_view();
+          if (field.type == FieldType::DATA) {
+            if (col < m_columns.size()) {
+              store(m_columns[col], field);
+            }
+            col++;
+            continue;
+          }
+          // Same rows as the iterator gives: an empty line is a row,
+          // nothing after the last terminator is not
+          if (field.type == FieldType::ROW_END || col > 0) {
+            for (size_t i = col; i < m_columns.size(); i++) {
+              store_missing(m_columns[i]);
+            }
+            m_fields.push_back(col);
+          }
+          if (field.type != FieldType::ROW_END) {
+            break;
+          }
+          col = 0;
+        }
+        return m_fields.size();
+      }
+
+      size_t rows() const {
+        return m_fields.size();
+      }
+
+      // Number of fields the row really had
+      size_t fields(size_t row) const {
+        return m_fields[row];
+      }
+
+      // The values of a number column, one per row
+      const double *numbers(size_t col) const {
+        return m_columns[col].numbers.empty() ? nullptr : &m_columns[col].numbers[0];
+      }
+
+      double number(size_t col, size_t row) const {
+        return m_columns[col].numbers[row];
+      }
+
+      // Text of a cell. For number columns only cells that did
+      // not parse have it, the rest give nullptr
+      const wchar_t *text(size_t col, size_t row) const {
+        const Column& column = m_columns[col];
+        if (column.text.empty() || column.text[row] == NPOS) {
+          return nullptr;
+        }
+        return &m_arena[column.text[row]];
+      }
+    private:
+      static const size_t NPOS = static_cast<size_t>(-1);
+
+      struct Column {
+        explicit Column(ColumnType t): type(t) {}
+
+        void reserve(size_t rows) {
+          if (type == ColumnType::NUMBER) {
+            numbers.reserve(rows);
+          }
+          if (type != ColumnType::SKIP) {
+            text.reserve(rows);
+          }
+        }
+
+        ColumnType type;
+        std::vector<double> numbers;
+        // Arena offsets of the cells
+        std::vector<size_t> text;
+      };
+
+      std::vector<Column> m_columns;
+      std::vector<size_t> m_fields;
+      std::vector<wchar_t> m_arena;
+
+      size_t add_text(const wchar_t *data, size_t size) {
+        if (size == 0) {
+          return 0;
+        }
+        size_t offset = m_arena.size();
+        m_arena.insert(m_arena.end(), data, data + size);
+        m_arena.push_back(L'\0');
+        return offset;
+      }
+
+      void store(Column& column, const FieldView& field) {
+        switch (column.type) {
+          case ColumnType::NUMBER: {
+            double value;
+            if (Numeric::ParseDouble(field.data, field.size, value) && value == value) {
+              column.numbers.push_back(value);
+              column.text.push_back(static_cast<size_t>(NPOS));
+            } else {
+              column.numbers.push_back(std::numeric_limits<double>::quiet_NaN());
+              column.text.push_back(add_text(field.data, field.size));
+            }
+            break;
+          }
+          case ColumnType::TEXT:
+            column.text.push_back(add_text(field.data, field.size));
+            break;
+          default:
+            break;
+        }
+      }
+
+      void store_missing(Column& column) {
+        if (column.type == ColumnType::NUMBER) {
+          column.numbers.push_back(std::numeric_limits<double>::quiet_NaN());
+        }
+        if (column.type != ColumnType::SKIP) {
+          column.text.push_back(0);
+        }
+      }
+    };
+  }
+}
+#endif
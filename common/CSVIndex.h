@@ -0,0 +1,161 @@
+#ifndef ARIA_CSV_INDEX_H
+#define ARIA_CSV_INDEX_H
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "CSVParser.h"
+
+namespace aria {
+  namespace csv {
+    // Byte offsets of every Nth row of a CSV, so a parser can jump close
+    // to any row instead of reading everything before it. The index can be
+    // kept in a sidecar file next to the data, the stamp saved along with
+    // it (e.g. size and write time of the data) tells if it went stale
+    class RowIndex {
+    public:
+      explicit RowIndex(size_t every = 1024):
+        m_every(every != 0 ? every : 1),
+        m_rows(0)
+      {}
+
+      // Rows between two recorded offsets
+      size_t every() const {
+        return m_every;
+      }
+
+      // Rows in the data, as the CsvParser iterator counts them
+      size_t rows() const {
+        return m_rows;
+      }
+
+      bool empty() const {
+        return m_offsets.empty();
+      }
+
+      // Reads the parser to the end recording where every Nth row starts.
+      // Fails if the parser's source can't tell byte offsets
+      bool build(CsvParser& parser) {
+        m_offsets.clear();
+        m_rows = 0;
+        long long offset = parser.offset();
+        if (offset < 0) {
+          return false;
+        }
+        m_offsets.push_back(offset);
+        bool fields = false;
+        for (;;) {
+          FieldView field = parser.next_field_view();
+          if (field.type == FieldType::DATA) {
+            fields = true;
+          } else if (field.type == FieldType::ROW_END) {
+            fields = false;
+            if (++m_rows % m_every == 0) {
+              m_offsets.push_back(parser.offset());
+            }
+          } else {
+            break;
+          }
+        }
+        // Last row without a terminator
+        if (fields) {
+          m_rows++;
+        }
+        // Drop the offset of a row that never started
+        if (m_offsets.size() > (m_rows + m_every - 1) / m_every && m_offsets.size() > 1) {
+          m_offsets.pop_back();
+        }
+        return true;
+      }
+
+      // Moves the parser to the start of the given row: seeks to the
+      // closest recorded row before it and skips the rest
+      bool seek(CsvParser& parser, size_t row) const {
+        if (row > m_rows || m_offsets.empty()) {
+          return false;
+        }
+        size_t slot = row / m_every;
+        if (slot >= m_offsets.size()) {
+          slot = m_offsets.size() - 1;
+        }
+        if (!parser.seek(m_offsets[slot])) {
+          return false;
+        }
+        for (size_t skip = row - slot * m_every; skip > 0; ) {
+          FieldView field = parser.next_field_view();
+          if (field.type == FieldType::ROW_END) {
+            skip--;
+          } else if (field.type != FieldType::DATA) {
+            return skip == 1;
+          }
+        }
+        return true;
+      }
+
+      // Writes the index in a little endian binary form
+      bool save(std::ostream& out, unsigned long long stamp) const {
+        put(out, MAGIC);
+        put(out, stamp);
+        put(out, m_every);
+        put(out, m_rows);
+        put(out, m_offsets.size());
+        for (size_t i = 0; i < m_offsets.size(); i++) {
+          put(out, static_cast<unsigned long long>(m_offsets[i]));
+        }
+        return out.good();
+      }
+
+      // Reads an index written by save(), fails if it's damaged
+      // or was saved with another stamp
+      bool load(std::istream& in, unsigned long long stamp) {
+        unsigned long long magic, saved, every, rows, count;
+        if (!get(in, magic) || magic != MAGIC || !get(in, saved) || saved != stamp ||
+            !get(in, every) || every == 0 || !get(in, rows) || !get(in, count) ||
+            count != (rows + every - 1) / every + (rows == 0 ? 1 : 0)) {
+          return false;
+        }
+        std::vector<long long> offsets(static_cast<size_t>(count));
+        for (size_t i = 0; i < offsets.size(); i++) {
+          unsigned long long offset;
+          if (!get(in, offset)) {
+            return false;
+          }
+          offsets[i] = static_cast<long long>(offset);
+        }
+        m_every = static_cast<size_t>(every);
+        m_rows = static_cast<size_t>(rows);
+        m_offsets.swap(offsets);
+        return true;
+      }
+    private:
+      // "CSVIDX" and the format version
+      static const unsigned long long MAGIC = 0x0001584449565343ULL;
+
+      size_t m_every;
+      size_t m_rows;
+      std::vector<long long> m_offsets;
+
+      static void put(std::ostream& out, unsigned long long value) {
+        char bytes[8];
+        for (int i = 0; i < 8; i++) {
+          bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+        out.write(bytes, 8);
+      }
+
+      static bool get(std::istream& in, unsigned long long& value) {
+        unsigned char bytes[8];
+        if (!in.read(reinterpret_cast<char *>(bytes), 8)) {
+          return false;
+        }
+        value = 0;
+        for (int i = 7; i >= 0; i--) {
+          value = (value << 8) | bytes[i];
+        }
+        return true;
+      }
+    };
+  }
+}
+#endif
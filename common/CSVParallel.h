@@ -0,0 +1,249 @@
+#ifndef ARIA_CSV_PARALLEL_H
+#define ARIA_CSV_PARALLEL_H
+
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "CSVParser.h"
+#include "CSVSource.h"
+
+namespace aria {
+  namespace csv {
+    // Parses bytes already in memory (e.g. a MappedFile) on several threads.
+    // The data is cut into chunks and every chunk is scanned for quotes and
+    // row terminators at once. Counting quotes in the chunks before tells
+    // whether a chunk starts inside a quoted field, so each chunk can pick
+    // its first real row start. The rows are then parsed per chunk and
+    // joined in order. A chunk that turns out not to end on a row boundary
+    // (quotes inside unquoted fields break the counting) makes the rest of
+    // the data be parsed on one thread, so the rows are always the same as
+    // the CsvParser iterator gives
+    class ParallelParser {
+    public:
+      ParallelParser(const void *data, size_t size, Encoding fallback = Encoding::CP1251):
+        m_data(static_cast<const unsigned char *>(data)),
+        m_size(size),
+        m_encoding(fallback),
+        m_quote('"'),
+        m_delimiter(','),
+        m_terminator(Term::CRLF),
+        m_threads(std::thread::hardware_concurrency()),
+        m_chunks(0)
+      {
+        m_begin = detect_bom(m_data, m_size, m_encoding);
+        // The chunks are parsed with the encoding as is, so data without
+        // a BOM is sniffed here once for all of them, as ByteSource does
+        if (m_begin == 0) {
+          m_encoding = sniff_encoding(m_data, m_size < SNIFF_SIZE ? m_size : SNIFF_SIZE, m_encoding);
+        }
+        m_width = (m_encoding == Encoding::UTF16LE || m_encoding == Encoding::UTF16BE) ? 2 : 1;
+        if (m_threads == 0) {
+          m_threads = 1;
+        }
+      }
+
+      ParallelParser& quote(wchar_t c) {
+        m_quote = c;
+        return *this;
+      }
+
+      ParallelParser& delimiter(wchar_t c) {
+        m_delimiter = c;
+        return *this;
+      }
+
+      ParallelParser& terminator(wchar_t c) {
+        m_terminator = static_cast<Term>(c);
+        return *this;
+      }
+
+      // Number of threads to use, 0 picks one per core
+      ParallelParser& threads(unsigned int n) {
+        m_threads = n != 0 ? n : std::thread::hardware_concurrency();
+        if (m_threads == 0) {
+          m_threads = 1;
+        }
+        return *this;
+      }
+
+      // Encoding of the data, from the BOM or sniffed
+      Encoding encoding() const {
+        return m_encoding;
+      }
+
+      // Number of chunks the last parse() really used
+      size_t chunks() const {
+        return m_chunks;
+      }
+
+      // Parses all the rows
+      CSV parse() {
+        std::vector<size_t> starts = split();
+        m_chunks = starts.size();
+        starts.push_back(m_size);
+
+        std::vector<CSV> parts(m_chunks);
+        std::vector<char> whole(m_chunks, 0);
+        run(m_chunks, [&](size_t i) {
+          whole[i] = parse_range(starts[i], starts[i + 1], parts[i]);
+        });
+
+        CSV rows;
+        size_t total = 0;
+        for (size_t i = 0; i < m_chunks; i++) {
+          total += parts[i].size();
+        }
+        rows.reserve(total);
+        for (size_t i = 0; i < m_chunks; i++) {
+          // The next chunk did not start on a row, redo the rest in one go
+          if (!whole[i] && i + 1 < m_chunks) {
+            CSV tail;
+            parse_range(starts[i], m_size, tail);
+            move_rows(tail, rows);
+            break;
+          }
+          move_rows(parts[i], rows);
+        }
+        return rows;
+      }
+    private:
+      // Chunks smaller than that are not worth a thread
+      static const size_t MIN_CHUNK = 1024 * 1024;
+      static const size_t NPOS = static_cast<size_t>(-1);
+
+      // Quote count of a chunk and the first row start in it, for both
+      // an even and an odd number of quotes seen before the terminator
+      struct ChunkScan {
+        size_t quotes;
+        size_t rowstart[2];
+      };
+
+      const unsigned char *m_data;
+      size_t m_size;
+      size_t m_begin;
+      size_t m_width;
+      Encoding m_encoding;
+      wchar_t m_quote;
+      wchar_t m_delimiter;
+      Term m_terminator;
+      unsigned int m_threads;
+      size_t m_chunks;
+
+      // Code unit at byte offset pos
+      unsigned int unit(size_t pos) const {
+        switch (m_encoding) {
+          case Encoding::UTF16LE:
+            return m_data[pos] | (m_data[pos + 1] << 8);
+          case Encoding::UTF16BE:
+            return (m_data[pos] << 8) | m_data[pos + 1];
+          default:
+            return m_data[pos];
+        }
+      }
+
+      // Runs fn(0) .. fn(n - 1), one thread each, fn(0) on the calling one
+      template<class Fn>
+      static void run(size_t n, Fn fn) {
+        std::vector<std::exception_ptr> errors(n);
+        std::vector<std::thread> workers;
+        workers.reserve(n);
+        for (size_t i = 1; i < n; i++) {
+          workers.push_back(std::thread([&fn, &errors, i]() {
+            try {
+              fn(i);
+            } catch (...) {
+              errors[i] = std::current_exception();
+            }
+          }));
+        }
+        try {
+          fn(0);
+        } catch (...) {
+          errors[0] = std::current_exception();
+        }
+        for (size_t i = 0; i < workers.size(); i++) {
+          workers[i].join();
+        }
+        for (size_t i = 0; i < n; i++) {
+          if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+          }
+        }
+      }
+
+      // Finds the offsets the chunks start at, the first one is always
+      // the start of the data
+      std::vector<size_t> split() const {
+        std::vector<size_t> starts(1, m_begin);
+        size_t size = m_size - m_begin;
+        size_t n = m_threads;
+        if (n > size / MIN_CHUNK) {
+          n = size / MIN_CHUNK;
+        }
+        // Only the code units are looked at, so with single byte units
+        // the quote and the terminator have to be plain ASCII
+        unsigned int term = m_terminator == Term::CRLF ? L'\n' : static_cast<unsigned int>(m_terminator);
+        unsigned int limit = m_width == 1 ? 0x80 : 0x10000;
+        if (n < 2 || static_cast<unsigned int>(m_quote) >= limit || term >= limit) {
+          return starts;
+        }
+
+        std::vector<size_t> bounds(n + 1);
+        for (size_t i = 0; i < n; i++) {
+          bounds[i] = m_begin + (size / n * i) / m_width * m_width;
+        }
+        bounds[n] = m_begin + size / m_width * m_width;
+
+        std::vector<ChunkScan> scans(n);
+        unsigned int quote = static_cast<unsigned int>(m_quote);
+        run(n, [&](size_t i) {
+          ChunkScan& scan = scans[i];
+          scan.quotes = 0;
+          scan.rowstart[0] = scan.rowstart[1] = NPOS;
+          for (size_t pos = bounds[i]; pos < bounds[i + 1]; pos += m_width) {
+            unsigned int c = m_width == 1 ? m_data[pos] : unit(pos);
+            if (c == quote) {
+              scan.quotes++;
+            } else if (c == term && scan.rowstart[scan.quotes & 1] == NPOS) {
+              scan.rowstart[scan.quotes & 1] = pos + m_width;
+            }
+          }
+        });
+
+        size_t quotes = scans[0].quotes;
+        for (size_t i = 1; i < n; i++) {
+          size_t start = scans[i].rowstart[quotes & 1];
+          if (start != NPOS && start > starts.back() && start < m_size) {
+            starts.push_back(start);
+          }
+          quotes += scans[i].quotes;
+        }
+        return starts;
+      }
+
+      // Parses [begin, end) into rows. Returns whether the
+      // range ended on a row boundary
+      bool parse_range(size_t begin, size_t end, CSV& rows) const {
+        MemorySource source(m_data + begin, end - begin, m_encoding, false);
+        CsvParser parser(source);
+        parser.quote(m_quote).delimiter(m_delimiter);
+        if (m_terminator != Term::CRLF) {
+          parser.terminator(static_cast<wchar_t>(m_terminator));
+        }
+        for (auto& row : parser) {
+          rows.push_back(row.strings());
+        }
+        return parser.ended_outside_field();
+      }
+
+      static void move_rows(CSV& from, CSV& to) {
+        for (size_t i = 0; i < from.size(); i++) {
+          to.push_back(std::move(from[i]));
+        }
+        CSV().swap(from);
+      }
+    };
+  }
+}
+#endif
@@ -1,18 +1,42 @@
 #ifndef ARIA_CSV_H
 #define ARIA_CSV_H
 
+#include <cstring>
 #include <fstream>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "scan.h"
+
+// Building with ARIA_CSV_STATS defined makes the parser keep the
+// counters of CsvParser::stats(), without it they all stay zero
+#ifdef ARIA_CSV_STATS
+#define ARIA_CSV_COUNT(counter, n) (m_stats.counter += (n))
+#else
+#define ARIA_CSV_COUNT(counter, n) ((void)0)
+#endif
+
 namespace aria {
   namespace csv {
     enum class Term : wchar_t { CRLF = 65534 };
-    enum class FieldType { DATA, ROW_END, CSV_END };
+    enum class FieldType { DATA, ROW_END, CSV_END, NEED_INPUT };
     typedef std::vector<std::vector<std::wstring>> CSV;
 
+    // What a parser went through, for measuring it
+    struct ParserStats {
+      // Characters taken from the source
+      unsigned long long chars;
+      // Times the source was asked for more
+      unsigned long long refills;
+      unsigned long long fields;
+      // ROW_END tokens handed out, the end of the last row is not one
+      unsigned long long rows;
+      // Fields that had to be copied into the field buffer
+      unsigned long long copied;
+    };
+
     // Checking for '\n', '\r', and '\r\n' by default
     inline bool operator==(const wchar_t c, const Term t) {
       switch (t) {
@@ -37,6 +61,203 @@ namespace aria {
       const std::wstring *data;
     };
 
+    // Same as Field, but points straight into the parser buffers instead of
+    // a string. The view is only valid until the next call to the parser
+    struct FieldView {
+      explicit FieldView(FieldType t): type(t), data(nullptr), size(0) {}
+      FieldView(const wchar_t *ptr, size_t len): type(FieldType::DATA), data(ptr), size(len) {}
+
+      FieldType type;
+      const wchar_t *data;
+      size_t size;
+
+      std::wstring str() const {
+        return std::wstring(data, size);
+      }
+    };
+
+    // Field of a Row, unlike a plain view it's always NUL terminated
+    struct FieldRef : FieldView {
+      FieldRef(const wchar_t *ptr, size_t len): FieldView(ptr, len) {}
+
+      const wchar_t *c_str() const {
+        return data;
+      }
+    };
+
+    // Fields of a row one after another in a single buffer, each one
+    // followed by a NUL. The storage stays between rows and only grows
+    // to fit the widest row seen, so refilling a row allocates nothing
+    class Row {
+    public:
+      size_t size() const {
+        return m_ends.size();
+      }
+
+      bool empty() const {
+        return m_ends.empty();
+      }
+
+      FieldRef operator[](size_t i) const {
+        size_t begin = i == 0 ? 0 : m_ends[i - 1] + 1;
+        return FieldRef(m_chars.data() + begin, m_ends[i] - begin);
+      }
+
+      // Copies of the fields, for keeping the row
+      std::vector<std::wstring> strings() const {
+        std::vector<std::wstring> fields;
+        fields.reserve(size());
+        for (size_t i = 0; i < size(); i++) {
+          fields.push_back((*this)[i].str());
+        }
+        return fields;
+      }
+
+      void clear() {
+        m_chars.clear();
+        m_ends.clear();
+      }
+
+      void push_back(const FieldView& field) {
+        m_chars.append(field.data, field.size);
+        m_ends.push_back(m_chars.size());
+        m_chars.push_back(L'\0');
+      }
+    private:
+      std::wstring m_chars;
+      std::vector<size_t> m_ends;
+    };
+
+    // Supplies characters to the parser
+    class Source {
+    public:
+      virtual ~Source() {}
+
+      // Reads up to cap characters into buf. Can return less than
+      // asked for, returns 0 only when the input is over
+      virtual size_t read(wchar_t *buf, size_t cap) = 0;
+
+      // Same as read, but may point data at characters of its own
+      // instead of copying them into buf
+      virtual size_t fetch(const wchar_t *&data, wchar_t *buf, size_t cap) {
+        data = buf;
+        return read(buf, cap);
+      }
+
+      // Whether running out of characters means the input is over.
+      // Sources fed by the caller say no until they are told otherwise
+      virtual bool finished() const {
+        return true;
+      }
+
+      // Byte offset in the data of the character at pos in the buffer
+      // the last read filled, -1 if the source can't tell
+      virtual long long offset(size_t /*pos*/) {
+        return -1;
+      }
+
+      // Makes the next read start at a byte offset given by offset()
+      virtual bool seek(long long /*pos*/) {
+        return false;
+      }
+    };
+
+    // Characters from a wide stream
+    class StreamSource : public Source {
+    public:
+      explicit StreamSource(std::wistream& input): m_input(input) {}
+
+      size_t read(wchar_t *buf, size_t cap) {
+        m_input.read(buf, static_cast<std::streamsize>(cap));
+        return static_cast<size_t>(m_input.gcount());
+      }
+    private:
+      std::wistream& m_input;
+
+      StreamSource& operator=(const StreamSource&);
+    };
+
+    // Picks the delimiter of the data out of the candidates (ASCII only,
+    // in order of preference). Every line is taken through a histogram of
+    // the candidates outside quotes, the winner is the one most lines have
+    // the same nonzero count of. Returns the fallback if none splits at
+    // least half of the lines evenly. The last line is only looked at when
+    // it's the only one, since the data may end in the middle of it
+    inline wchar_t sniff_delimiter(const wchar_t *data, size_t size, wchar_t quote,
+                                   const wchar_t *candidates, wchar_t fallback) {
+      static const size_t MAX_CANDIDATES = 8;
+      static const size_t MAX_LINES = 64;
+
+      // Histogram slot of every ASCII character, 0 for the rest
+      unsigned char slot[128] = {};
+      wchar_t chars[MAX_CANDIDATES];
+      size_t ncand = 0;
+      for (; *candidates != L'\0' && ncand < MAX_CANDIDATES; candidates++) {
+        wchar_t c = *candidates;
+        if (static_cast<unsigned int>(c) < 128 && c != quote && c != L'\r' && c != L'\n' && slot[c] == 0) {
+          chars[ncand] = c;
+          slot[c] = static_cast<unsigned char>(++ncand);
+        }
+      }
+      if (ncand == 0) {
+        return fallback;
+      }
+
+      // Candidate counts per line, slot 0 catches everything else
+      unsigned int counts[MAX_LINES][MAX_CANDIDATES + 1];
+      size_t lines = 0;
+      unsigned int hist[MAX_CANDIDATES + 1] = {};
+      bool quoted = false;
+      bool blank = true;
+      const wchar_t *end = data + size;
+      for (const wchar_t *p = data; p != end && lines < MAX_LINES; p++) {
+        wchar_t c = *p;
+        if (c == quote) {
+          quoted = !quoted;
+          blank = false;
+        } else if (quoted) {
+          continue;
+        } else if (c == L'\r' || c == L'\n') {
+          if (!blank) {
+            memcpy(counts[lines++], hist, sizeof(hist));
+          }
+          memset(hist, 0, sizeof(hist));
+          blank = true;
+        } else {
+          hist[static_cast<unsigned int>(c) < 128 ? slot[c] : 0]++;
+          blank = false;
+        }
+      }
+      if (lines == 0 && !blank) {
+        memcpy(counts[lines++], hist, sizeof(hist));
+      }
+
+      wchar_t best = fallback;
+      size_t bestlines = 0;
+      for (size_t k = 1; k <= ncand; k++) {
+        // Most common nonzero count of the candidate and how many lines have it
+        size_t modelines = 0;
+        for (size_t i = 0; i < lines; i++) {
+          unsigned int n = counts[i][k];
+          if (n == 0) {
+            continue;
+          }
+          size_t same = 0;
+          for (size_t j = 0; j < lines; j++) {
+            same += counts[j][k] == n;
+          }
+          if (same > modelines) {
+            modelines = same;
+          }
+        }
+        if (modelines > bestlines && modelines * 2 >= lines) {
+          best = chars[k - 1];
+          bestlines = modelines;
+        }
+      }
+      return best;
+    }
+
     // Reads and parses lines from a csv file
     class CsvParser {
     private:
@@ -50,12 +271,14 @@ namespace aria {
         EMPTY
       };
       State m_state;
+      State m_endstate;
 
       // Configurable attributes
       wchar_t m_quote;
       wchar_t m_delimiter;
       Term m_terminator;
-      std::wistream& m_input;
+      std::unique_ptr<Source> m_ownsource;
+      Source *m_source;
 
       // Buffer capacities
       static const int FIELDBUF_CAP = 1024;
@@ -64,39 +287,47 @@ namespace aria {
       // Buffers
       std::wstring m_fieldbuf;
       wchar_t *m_inputbuf;
+      // Characters being parsed, the input buffer or the source's own
+      const wchar_t *m_buffer;
+
+      // Part of the input buffer that belongs to the current field
+      // but is not yet copied into the field buffer
+      size_t m_spanbegin;
+      size_t m_spanend;
 
       // Misc
       bool m_eof;
+      // The field was cut short by NEED_INPUT
+      bool m_resume;
+      // A '\r' ended the last input, a '\n' starting the next one belongs to it
+      bool m_pendingcr;
       size_t m_cursor;
       size_t m_inputbuf_size;
       std::streamoff m_scanposition;
+      ParserStats m_stats;
     public:
       // Creates the CSV parser which by default, splits on commas,
       // uses quotes to escape, and handles CSV files that end in either
       // '\r', '\n', or '\r\n'.
       explicit CsvParser(std::wistream& input):
-        m_input(input),
-        m_state(State::START_OF_FIELD),
-        m_quote('"'),
-        m_delimiter(','),
-        m_terminator(Term::CRLF),
-        m_eof(false),
-        m_cursor(INPUTBUF_CAP),
-        m_inputbuf(nullptr),
-        m_inputbuf_size(INPUTBUF_CAP),
-        m_scanposition(-INPUTBUF_CAP)
+        m_ownsource(new StreamSource(input))
       {
-        m_inputbuf = new wchar_t[INPUTBUF_CAP];
-        if (m_inputbuf == nullptr) {
-          throw std::runtime_error("buffer allocation error");
-        }
-        // Reserve space upfront to improve performance
-        m_fieldbuf.reserve(FIELDBUF_CAP);
-        if (!m_input.good()) {
+        init(*m_ownsource);
+        if (!input.good()) {
           throw std::runtime_error("Something is wrong with input stream");
         }
       }
 
+      // Same as above, but reads from a source that is not owned by the
+      // parser and must outlive it
+      explicit CsvParser(Source& source) {
+        init(source);
+      }
+
+      ~CsvParser() {
+        delete[] m_inputbuf;
+      }
+
       // Change the quote character
       CsvParser& quote(wchar_t c) {
         m_quote = c;
@@ -115,12 +346,39 @@ namespace aria {
         return *this;
       }
 
+      // Sets the delimiter from the first block of the input, see
+      // sniff_delimiter(). Has to be called before anything is parsed,
+      // returns the delimiter the parser goes on with
+      wchar_t sniff(const wchar_t *candidates = L";,\t") {
+        if (top_token()) {
+          m_delimiter = sniff_delimiter(m_buffer + m_cursor, m_inputbuf_size - m_cursor,
+                                        m_quote, candidates, m_delimiter);
+        }
+        return m_delimiter;
+      }
+
+      // Current delimiter character
+      wchar_t delimiter() const {
+        return m_delimiter;
+      }
+
+      // Counters since the parser was created, see ARIA_CSV_STATS
+      const ParserStats& stats() const {
+        return m_stats;
+      }
+
       // The parser is in the empty state when there are
       // no more tokens left to read from the input buffer
       bool empty() {
         return m_state == State::EMPTY;
       }
 
+      // Whether the input ran out between fields rather than inside one,
+      // e.g. right after a row terminator. Only meaningful once empty()
+      bool ended_outside_field() const {
+        return m_endstate == State::START_OF_FIELD || m_endstate == State::END_OF_ROW;
+      }
+
       // Not the actual position in the stream (its buffered) just the
       // position up to last availiable token
       std::streamoff position() const
@@ -128,23 +386,86 @@ namespace aria {
           return m_scanposition + static_cast<std::streamoff>(m_cursor);
       }
 
+      // Byte offset in the source of the next character to be parsed,
+      // -1 if the source can't tell. Meant to be asked between rows
+      long long offset() {
+        if (m_cursor == m_inputbuf_size && !m_eof) {
+          top_token();
+        }
+        return m_source->offset(m_cursor);
+      }
+
+      // Continues parsing at a byte offset given by offset(), the offset
+      // has to be the start of a row. position() counts from there on
+      bool seek(long long pos) {
+        if (!m_source->seek(pos)) {
+          return false;
+        }
+        m_state = State::START_OF_FIELD;
+        m_endstate = State::START_OF_FIELD;
+        m_fieldbuf.clear();
+        m_spanbegin = m_spanend = 0;
+        m_eof = false;
+        m_resume = false;
+        m_pendingcr = false;
+        m_cursor = INPUTBUF_CAP;
+        m_inputbuf_size = INPUTBUF_CAP;
+        m_scanposition = -INPUTBUF_CAP;
+        return true;
+      }
+
       // Reads a single field from the CSV
       Field next_field() {
+        FieldView field = next_field_view();
+        if (field.type != FieldType::DATA) {
+          return Field(field.type);
+        }
+        if (field.data != m_fieldbuf.data()) {
+          m_fieldbuf.assign(field.data, field.size);
+        }
+        return Field(m_fieldbuf);
+      }
+
+      // Reads a single field from the CSV without copying it. Unquoted
+      // fields and quoted fields without escaped quotes point straight into
+      // the input buffer, the field buffer is only used when the field has
+      // to be unescaped or crosses a buffer refill
+      FieldView next_field_view() {
         if (empty()) {
-          return Field(FieldType::CSV_END);
+          return FieldView(FieldType::CSV_END);
+        }
+        // A field cut short by the end of the available input goes on
+        if (m_resume) {
+          m_resume = false;
+        } else {
+          m_fieldbuf.clear();
+          m_spanbegin = m_spanend = 0;
         }
-        m_fieldbuf.clear();
 
         // This loop runs until either the parser has
         // read a full field or until there's no tokens left to read
         for (;;) {
-          wchar_t *maybe_token = top_token();
+          const wchar_t *maybe_token = top_token();
+
+          // The source has nothing right now but more will come, the
+          // part of the field read so far is already in the field buffer
+          if (!maybe_token && !m_eof) {
+            // Nothing that comes can add to a row already terminated
+            if (m_state == State::END_OF_ROW) {
+              m_state = State::START_OF_FIELD;
+              ARIA_CSV_COUNT(rows, 1);
+              return FieldView(FieldType::ROW_END);
+            }
+            m_resume = true;
+            return FieldView(FieldType::NEED_INPUT);
+          }
 
           // If we're out of tokens to read return whatever's left in the
           // field and row buffers. If there's nothing left, return null.
           if (!maybe_token) {
+            m_endstate = m_state;
             m_state = State::EMPTY;
-            return !m_fieldbuf.empty() ? Field(m_fieldbuf) : Field(FieldType::CSV_END);
+            return field_pending() ? field_view() : FieldView(FieldType::CSV_END);
           }
 
           // Parsing the CSV is done using a finite state machine
@@ -154,45 +475,53 @@ namespace aria {
               m_cursor++;
               if (c == m_terminator) {
                 handle_crlf(c);
-                return Field(FieldType::ROW_END);
+                ARIA_CSV_COUNT(rows, 1);
+                return FieldView(FieldType::ROW_END);
               }
 
               if (c == m_quote) {
                 m_state = State::IN_QUOTED_FIELD;
               } else if (c == m_delimiter) {
-                return Field(m_fieldbuf);
+                return field_view();
               } else {
                 m_state = State::IN_FIELD;
-                m_fieldbuf += c;
+                append(m_cursor - 1);
               }
 
               break;
 
             case State::IN_FIELD:
+              // Consume everything up to the next delimiter or terminator at once
+              if (c != m_delimiter && c != m_terminator) {
+                append_run(m_cursor, scan_field());
+                break;
+              }
+
               m_cursor++;
               if (c == m_terminator) {
                 handle_crlf(c);
                 m_state = State::END_OF_ROW;
-                return Field(m_fieldbuf);
+                return field_view();
               }
 
               if (c == m_delimiter) {
                 m_state = State::START_OF_FIELD;
-                return Field(m_fieldbuf);
+                return field_view();
               } else {
-                m_fieldbuf += c;
+                append(m_cursor - 1);
               }
 
               break;
 
             case State::IN_QUOTED_FIELD:
-              m_cursor++;
-              if (c == m_quote) {
-                m_state = State::IN_ESCAPED_QUOTE;
-              } else {
-                m_fieldbuf += c;
+              // Only a quote can end the quoted run
+              if (c != m_quote) {
+                append_run(m_cursor, scan_quoted());
+                break;
               }
 
+              m_cursor++;
+              m_state = State::IN_ESCAPED_QUOTE;
               break;
 
             case State::IN_ESCAPED_QUOTE:
@@ -200,25 +529,26 @@ namespace aria {
               if (c == m_terminator) {
                 handle_crlf(c);
                 m_state = State::END_OF_ROW;
-                return Field(m_fieldbuf);
+                return field_view();
               }
 
               if (c == m_quote) {
                 m_state = State::IN_QUOTED_FIELD;
-                m_fieldbuf += c;
+                append(m_cursor - 1);
               } else if (c == m_delimiter) {
                 m_state = State::START_OF_FIELD;
-                return Field(m_fieldbuf);
+                return field_view();
               } else {
                 m_state = State::IN_FIELD;
-                m_fieldbuf += c;
+                append(m_cursor - 1);
               }
 
               break;
 
             case State::END_OF_ROW:
               m_state = State::START_OF_FIELD;
-              return Field(FieldType::ROW_END);
+              ARIA_CSV_COUNT(rows, 1);
+              return FieldView(FieldType::ROW_END);
 
             case State::EMPTY:
               throw std::logic_error("You goofed");
@@ -226,6 +556,101 @@ namespace aria {
         }
       }
     private:
+      CsvParser(const CsvParser&);
+      CsvParser& operator=(const CsvParser&);
+
+      void init(Source& source) {
+        m_source = &source;
+        m_state = State::START_OF_FIELD;
+        m_endstate = State::START_OF_FIELD;
+        m_quote = '"';
+        m_delimiter = ',';
+        m_terminator = Term::CRLF;
+        m_spanbegin = 0;
+        m_spanend = 0;
+        m_eof = false;
+        m_resume = false;
+        m_pendingcr = false;
+        m_cursor = INPUTBUF_CAP;
+        m_inputbuf_size = INPUTBUF_CAP;
+        m_scanposition = -INPUTBUF_CAP;
+        memset(&m_stats, 0, sizeof(m_stats));
+        m_inputbuf = new wchar_t[INPUTBUF_CAP];
+        m_buffer = m_inputbuf;
+        if (m_inputbuf == nullptr) {
+          throw std::runtime_error("buffer allocation error");
+        }
+        // Reserve space upfront to improve performance
+        m_fieldbuf.reserve(FIELDBUF_CAP);
+      }
+
+      // Adds the input buffer character at pos to the current field.
+      // Adjacent characters just grow the pending span, the span is
+      // copied into the field buffer only when it can't be grown anymore
+      void append(size_t pos) {
+        if (m_spanend != pos) {
+          flush_span();
+          m_spanbegin = pos;
+        }
+        m_spanend = pos + 1;
+      }
+
+      // Adds the input buffer characters [begin, end) to the current field
+      // and moves the cursor past them
+      void append_run(size_t begin, size_t end) {
+        if (m_spanend != begin) {
+          flush_span();
+          m_spanbegin = begin;
+        }
+        m_spanend = end;
+        m_cursor = end;
+      }
+
+      // Finds the next delimiter or terminator in the input buffer,
+      // returns the input buffer size if there's none
+      size_t scan_field() const {
+        const wchar_t *begin = m_buffer + m_cursor;
+        const wchar_t *end = m_buffer + m_inputbuf_size;
+        const wchar_t *found;
+        if (m_terminator == Term::CRLF) {
+          found = Scan::FindAny(begin, end, m_delimiter, L'\r', L'\n');
+        } else {
+          found = Scan::FindAny(begin, end, m_delimiter, static_cast<wchar_t>(m_terminator));
+        }
+        return static_cast<size_t>(found - m_buffer);
+      }
+
+      // Finds the next quote in the input buffer,
+      // returns the input buffer size if there's none
+      size_t scan_quoted() const {
+        const wchar_t *found = Scan::Find(m_buffer + m_cursor, m_buffer + m_inputbuf_size, m_quote);
+        return static_cast<size_t>(found - m_buffer);
+      }
+
+      // Moves the pending span into the field buffer
+      void flush_span() {
+        if (m_spanend > m_spanbegin) {
+          m_fieldbuf.append(m_buffer + m_spanbegin, m_spanend - m_spanbegin);
+        }
+        m_spanbegin = m_spanend = 0;
+      }
+
+      bool field_pending() const {
+        return !m_fieldbuf.empty() || m_spanend > m_spanbegin;
+      }
+
+      // Returns the current field, pointing into the input buffer
+      // if the field has never been copied into the field buffer
+      FieldView field_view() {
+        ARIA_CSV_COUNT(fields, 1);
+        if (m_fieldbuf.empty()) {
+          return FieldView(m_buffer + m_spanbegin, m_spanend - m_spanbegin);
+        }
+        ARIA_CSV_COUNT(copied, 1);
+        flush_span();
+        return FieldView(m_fieldbuf.data(), m_fieldbuf.size());
+      }
+
       // When the parser hits the end of a line it needs
       // to check the special case of '\r\n' as a terminator.
       // If it finds that the previous token was a '\r', and
@@ -235,51 +660,63 @@ namespace aria {
           return;
         }
 
-        wchar_t *token = top_token();
+        const wchar_t *token = top_token();
         if (token && *token == L'\n') {
           m_cursor++;
+        } else if (!token && !m_eof) {
+          // Can't tell yet, look at the next input when it comes
+          m_pendingcr = true;
         }
       }
 
       // Pulls the next token from the input buffer, but does not move
       // the cursor forward. If the stream is empty and the input buffer
       // is also empty return a nullptr.
-      wchar_t* top_token() {
-        // Return null if there's nothing left to read
-        if (m_eof && m_cursor == m_inputbuf_size) {
-          return nullptr;
-        }
+      const wchar_t* top_token() {
+        while (m_cursor == m_inputbuf_size) {
+          // Return null if there's nothing left to read
+          if (m_eof) {
+            return nullptr;
+          }
 
-        // Refill the input buffer if it's been fully read
-        if (m_cursor == m_inputbuf_size) {
+          // Refill the input buffer if it's been fully read,
+          // saving the part of the field it holds first
+          flush_span();
           m_scanposition += static_cast<std::streamoff>(m_cursor);
           m_cursor = 0;
-          m_input.read(m_inputbuf, INPUTBUF_CAP);
-
-          // Indicate we hit end of file, and resize
-          // input buffer to show that it's not at full capacity
-          if (m_input.eof()) {
-            m_eof = true;
-            m_inputbuf_size = (size_t)m_input.gcount();
+          m_inputbuf_size = m_source->fetch(m_buffer, m_inputbuf, INPUTBUF_CAP);
+          ARIA_CSV_COUNT(refills, 1);
+          ARIA_CSV_COUNT(chars, m_inputbuf_size);
+
+          // Indicate we hit end of file, unless the source is
+          // only waiting for more input
+          if (m_inputbuf_size == 0) {
+            m_eof = m_source->finished();
+            return nullptr;
+          }
 
-            // Return null if there's nothing left to read
-            if (m_inputbuf_size == 0) {
-              return nullptr;
+          // The '\n' of a '\r\n' split between two inputs
+          if (m_pendingcr) {
+            m_pendingcr = false;
+            if (m_buffer[0] == L'\n') {
+              m_cursor++;
             }
           }
         }
 
-        return &m_inputbuf[m_cursor];
+        return &m_buffer[m_cursor];
       }
     public:
       // Iterator implementation for the CSV parser, which reads
-      // from the CSV row by row in the form of a vector of strings
+      // from the CSV row by row in the form of a Row. The same Row
+      // is refilled every time, so a row is only valid until the next
+      // one is read and once it has grown parsing allocates nothing
       class iterator {
       public:
        typedef std::ptrdiff_t difference_type;
-       typedef std::vector<std::wstring> value_type;
-       typedef const std::vector<std::wstring>* pointer;
-       typedef const std::vector<std::wstring>& reference;
+       typedef Row value_type;
+       typedef const Row* pointer;
+       typedef const Row& reference;
        typedef std::input_iterator_tag iterator_category;
 
         explicit iterator(CsvParser *p, bool end = false):
@@ -287,7 +724,6 @@ namespace aria {
           m_current_row(-1)
         {
           if (!end) {
-            m_row.reserve(50);
             m_current_row = 0;
             next();
           }
@@ -326,29 +762,19 @@ namespace aria {
         int m_current_row;
 
         void next() {
-          value_type::size_type num_fields = 0;
+          m_row.clear();
           for (;;) {
-            auto field = m_parser->next_field();
+            FieldView field = m_parser->next_field_view();
             switch (field.type) {
               case FieldType::CSV_END:
-                if (num_fields < m_row.size()) {
-                  m_row.resize(num_fields);
-                }
+              case FieldType::NEED_INPUT:
                 m_current_row = -1;
                 return;
               case FieldType::ROW_END:
-                if (num_fields < m_row.size()) {
-                  m_row.resize(num_fields);
-                }
                 m_current_row++;
                 return;
               case FieldType::DATA:
-                if (num_fields < m_row.size()) {
-                  m_row[num_fields] = std::move(*field.data);
-                } else {
-                  m_row.push_back(std::move(*field.data));
-                }
-                num_fields++;
+                m_row.push_back(field);
             }
           }
         }
@@ -0,0 +1,235 @@
+#ifndef ARIA_CSV_PUSH_H
+#define ARIA_CSV_PUSH_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CSVParser.h"
+#include "CSVSource.h"
+
+namespace aria {
+  namespace csv {
+    // Characters handed over by the caller one slice at a time. A slice is
+    // parsed where it is, it only has to stay valid until the next one
+    class SliceSource : public Source {
+    public:
+      SliceSource():
+        m_data(nullptr),
+        m_size(0),
+        m_finished(false)
+      {}
+
+      void set(const wchar_t *data, size_t size) {
+        m_data = data;
+        m_size = size;
+      }
+
+      // No slices will follow
+      void finish() {
+        m_finished = true;
+      }
+
+      size_t read(wchar_t *buf, size_t cap) {
+        size_t n = m_size < cap ? m_size : cap;
+        wmemcpy(buf, m_data, n);
+        m_data += n;
+        m_size -= n;
+        return n;
+      }
+
+      size_t fetch(const wchar_t *&data, wchar_t * /*buf*/, size_t /*cap*/) {
+        data = m_data;
+        size_t n = m_size;
+        m_data += n;
+        m_size = 0;
+        return n;
+      }
+
+      bool finished() const {
+        return m_finished && m_size == 0;
+      }
+    private:
+      const wchar_t *m_data;
+      size_t m_size;
+      bool m_finished;
+    };
+
+    // Parses input the caller pushes in pieces of any size, e.g. from the
+    // clipboard or a pipe, and hands every row to a callback as soon as its
+    // terminator is in. A field, a quoted run or a "\r\n" split between two
+    // pieces is carried over to the next one. Wide pieces are parsed in
+    // place, byte pieces are decoded first, keeping a split multibyte
+    // sequence for later
+    class PushParser {
+    public:
+      typedef std::function<void (const Row&)> RowHandler;
+
+      explicit PushParser(RowHandler handler, Encoding fallback = Encoding::CP1251):
+        m_parser(m_source),
+        m_handler(handler),
+        m_encoding(fallback),
+        m_started(false),
+        m_rows(0)
+      {}
+
+      PushParser& quote(wchar_t c) {
+        m_parser.quote(c);
+        return *this;
+      }
+
+      PushParser& delimiter(wchar_t c) {
+        m_parser.delimiter(c);
+        return *this;
+      }
+
+      PushParser& terminator(wchar_t c) {
+        m_parser.terminator(c);
+        return *this;
+      }
+
+      // Rows handed to the callback so far
+      size_t rows() const {
+        return m_rows;
+      }
+
+      // Encoding of the bytes, the fallback one
+      // unless they started with a byte order mark
+      Encoding encoding() const {
+        return m_encoding;
+      }
+
+      // Parses a piece of wide characters
+      void feed(const wchar_t *data, size_t size) {
+        m_source.set(data, size);
+        pump();
+      }
+
+      // Parses a piece of encoded bytes
+      void feed_bytes(const void *data, size_t size) {
+        const unsigned char *in = static_cast<const unsigned char *>(data);
+        const unsigned char *end = in + size;
+        std::string head;
+        if (!m_started) {
+          // The byte order mark may be split too
+          m_pending.append(reinterpret_cast<const char *>(in), size);
+          if (m_pending.size() < 3) {
+            return;
+          }
+          start(head);
+          in = reinterpret_cast<const unsigned char *>(head.data());
+          end = in + head.size();
+        }
+        decode_piece(in, end);
+        pump();
+      }
+
+      // Ends the input, the last row goes to the callback
+      // even if it has no terminator
+      void finish() {
+        if (!m_started) {
+          std::string head;
+          start(head);
+          const unsigned char *in = reinterpret_cast<const unsigned char *>(head.data());
+          decode_piece(in, in + head.size());
+        } else {
+          m_chars.clear();
+        }
+        // Bytes of an unfinished sequence
+        if (!m_pending.empty()) {
+          m_pending.clear();
+          m_chars.push_back(REPLACEMENT_CHAR);
+        }
+        m_source.set(m_chars.empty() ? nullptr : &m_chars[0], m_chars.size());
+        m_source.finish();
+        pump();
+      }
+    private:
+      SliceSource m_source;
+      CsvParser m_parser;
+      RowHandler m_handler;
+      Encoding m_encoding;
+      bool m_started;
+      size_t m_rows;
+      Row m_row;
+      // Decoded characters of the last byte piece
+      std::vector<wchar_t> m_chars;
+      // Bytes of a sequence the last piece ended in the middle of
+      std::string m_pending;
+
+      PushParser(const PushParser&);
+      PushParser& operator=(const PushParser&);
+
+      void start(std::string& head) {
+        m_started = true;
+        size_t bom = detect_bom(reinterpret_cast<const unsigned char *>(m_pending.data()), m_pending.size(), m_encoding);
+        head.assign(m_pending, bom, std::string::npos);
+        m_pending.clear();
+      }
+
+      // Decodes into m_chars and points the source at them
+      void decode_piece(const unsigned char *in, const unsigned char *end) {
+        // Every byte makes one character at most
+        m_chars.resize(m_pending.size() + static_cast<size_t>(end - in) + 1);
+        wchar_t *begin = &m_chars[0];
+        wchar_t *out = begin;
+        wchar_t *outend = begin + m_chars.size();
+        if (!m_pending.empty()) {
+          // Finish the split sequence with the first bytes of this piece
+          unsigned char tmp[8];
+          size_t held = m_pending.size();
+          size_t taken = static_cast<size_t>(end - in);
+          if (taken > sizeof(tmp) - held) {
+            taken = sizeof(tmp) - held;
+          }
+          memcpy(tmp, m_pending.data(), held);
+          memcpy(tmp + held, in, taken);
+          const unsigned char *t = tmp;
+          decode(m_encoding, t, tmp + held + taken, out, outend);
+          size_t used = static_cast<size_t>(t - tmp);
+          if (used >= held) {
+            in += used - held;
+            m_pending.clear();
+          } else {
+            m_pending.assign(reinterpret_cast<const char *>(t), held + taken - used);
+            in += taken;
+          }
+        }
+        if (m_pending.empty()) {
+          decode(m_encoding, in, end, out, outend);
+          m_pending.assign(reinterpret_cast<const char *>(in), static_cast<size_t>(end - in));
+        }
+        m_chars.resize(static_cast<size_t>(out - begin));
+        m_source.set(m_chars.empty() ? nullptr : &m_chars[0], m_chars.size());
+      }
+
+      void pump() {
+        for (;;) {
+          FieldView field = m_parser.next_field_view();
+          switch (field.type) {
+            case FieldType::DATA:
+              m_row.push_back(field);
+              break;
+            case FieldType::ROW_END:
+              emit();
+              break;
+            case FieldType::CSV_END:
+              if (!m_row.empty()) {
+                emit();
+              }
+              return;
+            case FieldType::NEED_INPUT:
+              return;
+          }
+        }
+      }
+
+      void emit() {
+        m_rows++;
+        m_handler(m_row);
+        m_row.clear();
+      }
+    };
+  }
+}
+#endif
@@ -0,0 +1,619 @@
+#ifndef ARIA_CSV_SOURCE_H
+#define ARIA_CSV_SOURCE_H
+
+#include <string.h>
+#include <wchar.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "CSVParser.h"
+
+namespace aria {
+  namespace csv {
+    enum class Encoding { CP1251, UTF8, UTF16LE, UTF16BE };
+
+    const wchar_t REPLACEMENT_CHAR = 0xFFFD;
+
+    // Decodes CP1251 bytes, every byte makes exactly one character
+    inline void decode_cp1251(const unsigned char *&in, const unsigned char *inend, wchar_t *&out, wchar_t *outend) {
+      static const wchar_t upper[128] = {
+        0x0402, 0x0403, 0x201A, 0x0453, 0x201E, 0x2026, 0x2020, 0x2021,
+        0x20AC, 0x2030, 0x0409, 0x2039, 0x040A, 0x040C, 0x040B, 0x040F,
+        0x0452, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+        0x0098, 0x2122, 0x0459, 0x203A, 0x045A, 0x045C, 0x045B, 0x045F,
+        0x00A0, 0x040E, 0x045E, 0x0408, 0x00A4, 0x0490, 0x00A6, 0x00A7,
+        0x0401, 0x00A9, 0x0404, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x0407,
+        0x00B0, 0x00B1, 0x0406, 0x0456, 0x0491, 0x00B5, 0x00B6, 0x00B7,
+        0x0451, 0x2116, 0x0454, 0x00BB, 0x0458, 0x0405, 0x0455, 0x0457,
+        0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+        0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+        0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+        0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+        0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+        0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+        0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+        0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+      };
+      size_t n = static_cast<size_t>(inend - in);
+      if (n > static_cast<size_t>(outend - out)) {
+        n = static_cast<size_t>(outend - out);
+      }
+      for (size_t i = 0; i < n; i++) {
+        unsigned char c = in[i];
+        out[i] = c < 0x80 ? static_cast<wchar_t>(c) : upper[c - 0x80];
+      }
+      in += n;
+      out += n;
+    }
+
+    // Decodes UTF-16 code units. Surrogate pairs are passed through as is
+    inline void decode_utf16(bool bigendian, const unsigned char *&in, const unsigned char *inend, wchar_t *&out, wchar_t *outend) {
+      size_t n = static_cast<size_t>(inend - in) / 2;
+      if (n > static_cast<size_t>(outend - out)) {
+        n = static_cast<size_t>(outend - out);
+      }
+      const int hi = bigendian ? 0 : 1;
+      for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<wchar_t>((in[2 * i + hi] << 8) | in[2 * i + 1 - hi]);
+      }
+      in += 2 * n;
+      out += n;
+    }
+
+    // Decodes UTF-8. Malformed sequences become REPLACEMENT_CHAR, characters
+    // outside of the BMP become surrogate pairs when wchar_t is 16 bit wide
+    inline void decode_utf8(const unsigned char *&in, const unsigned char *inend, wchar_t *&out, wchar_t *outend) {
+      const unsigned char *p = in;
+      wchar_t *o = out;
+      while (p < inend && o < outend) {
+        unsigned int c = *p;
+        if (c < 0x80) {
+          // Plain ASCII is copied eight bytes at a time
+          while (inend - p >= 8 && outend - o >= 8) {
+            unsigned long long block;
+            memcpy(&block, p, 8);
+            if ((block & 0x8080808080808080ULL) != 0) {
+              break;
+            }
+            for (int i = 0; i < 8; i++) {
+              o[i] = static_cast<wchar_t>(p[i]);
+            }
+            p += 8;
+            o += 8;
+          }
+          if (p < inend && o < outend && *p < 0x80) {
+            *o++ = static_cast<wchar_t>(*p++);
+          }
+          continue;
+        }
+
+        // Lead byte tells the length, the first continuation byte range
+        // rules out overlong forms, surrogates and values above U+10FFFF
+        size_t avail = static_cast<size_t>(inend - p);
+        size_t len;
+        unsigned int lo = 0x80, hi = 0xBF;
+        if (c < 0xC2) {
+          len = 0;
+        } else if (c < 0xE0) {
+          len = 2;
+          c &= 0x1F;
+        } else if (c < 0xF0) {
+          len = 3;
+          c &= 0x0F;
+          if (c == 0x00) lo = 0xA0;
+          if (c == 0x0D) hi = 0x9F;
+        } else if (c < 0xF5) {
+          len = 4;
+          c &= 0x07;
+          if (c == 0x00) lo = 0x90;
+          if (c == 0x04) hi = 0x8F;
+        } else {
+          len = 0;
+        }
+
+        size_t used = 1;
+        bool valid = len != 0;
+        for (; valid && used < len; used++) {
+          if (used == avail) {
+            // Incomplete sequence, leave it for the next call
+            in = p;
+            out = o;
+            return;
+          }
+          unsigned int cc = p[used];
+          if (cc < lo || cc > hi) {
+            valid = false;
+            break;
+          }
+          lo = 0x80;
+          hi = 0xBF;
+          c = (c << 6) | (cc & 0x3F);
+        }
+
+        if (!valid) {
+          *o++ = REPLACEMENT_CHAR;
+        } else if (c > 0xFFFF) {
+#if WCHAR_MAX > 0xFFFF
+          *o++ = static_cast<wchar_t>(c);
+#else
+          if (outend - o < 2) {
+            break;
+          }
+          c -= 0x10000;
+          *o++ = static_cast<wchar_t>(0xD800 + (c >> 10));
+          *o++ = static_cast<wchar_t>(0xDC00 + (c & 0x3FF));
+#endif
+        } else {
+          *o++ = static_cast<wchar_t>(c);
+        }
+        p += used;
+      }
+      in = p;
+      out = o;
+    }
+
+    // Decodes as many complete characters from [in, in_end) as fit into
+    // [out, out_end), advancing both. An incomplete sequence at the end
+    // of the input is left in place
+    inline void decode(Encoding enc, const unsigned char *&in, const unsigned char *inend, wchar_t *&out, wchar_t *outend) {
+      switch (enc) {
+        case Encoding::UTF8:
+          decode_utf8(in, inend, out, outend);
+          break;
+        case Encoding::UTF16LE:
+          decode_utf16(false, in, inend, out, outend);
+          break;
+        case Encoding::UTF16BE:
+          decode_utf16(true, in, inend, out, outend);
+          break;
+        default:
+          decode_cp1251(in, inend, out, outend);
+      }
+    }
+
+    // Looks for a byte order mark at the start of the data.
+    // Returns its length, or 0 and leaves enc intact if there's none
+    inline size_t detect_bom(const unsigned char *data, size_t size, Encoding& enc) {
+      if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        enc = Encoding::UTF8;
+        return 3;
+      }
+      if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+        enc = Encoding::UTF16LE;
+        return 2;
+      }
+      if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+        enc = Encoding::UTF16BE;
+        return 2;
+      }
+      return 0;
+    }
+
+    // Bytes looked at to tell the encoding of data without a BOM
+    const size_t SNIFF_SIZE = 64 * 1024;
+
+    // Guesses the encoding of data that has no byte order mark. Zero bytes
+    // in every other position mean UTF-16, something besides ASCII that is
+    // all well formed UTF-8 means UTF-8, anything else is the fallback.
+    // A sequence cut by the end of the data does not count against UTF-8
+    inline Encoding sniff_encoding(const unsigned char *data, size_t size, Encoding fallback) {
+      size_t zeros[2] = { 0, 0 };
+      for (size_t i = 0; i + 1 < size; i += 2) {
+        zeros[0] += data[i] == 0;
+        zeros[1] += data[i + 1] == 0;
+      }
+      // ASCII delimiters and digits have a zero high byte
+      size_t units = size / 2;
+      if (zeros[1] * 8 >= units && zeros[0] == 0 && units > 0) {
+        return Encoding::UTF16LE;
+      }
+      if (zeros[0] * 8 >= units && zeros[1] == 0 && units > 0) {
+        return Encoding::UTF16BE;
+      }
+
+      const unsigned char *in = data;
+      const unsigned char *end = data + size;
+      bool ascii = true;
+      wchar_t buf[256];
+      while (in != end) {
+        wchar_t *out = buf;
+        decode_utf8(in, end, out, buf + 256);
+        if (out == buf) {
+          break;
+        }
+        for (wchar_t *p = buf; p != out; p++) {
+          if (*p == REPLACEMENT_CHAR) {
+            return fallback;
+          }
+          ascii = ascii && *p < 0x80;
+        }
+      }
+      return ascii ? fallback : Encoding::UTF8;
+    }
+
+    // Name of the encoding to show to the user
+    inline const wchar_t *encoding_name(Encoding enc) {
+      switch (enc) {
+        case Encoding::UTF8:
+          return L"UTF-8";
+        case Encoding::UTF16LE:
+          return L"UTF-16LE";
+        case Encoding::UTF16BE:
+          return L"UTF-16BE";
+        default:
+          return L"Windows-1251";
+      }
+    }
+
+    // Source decoding raw bytes in the same pass they are handed to the
+    // parser. The encoding comes from the byte order mark, data without
+    // one is sniffed from the first block (see sniff_encoding()) and taken
+    // as the fallback encoding (CP1251 by default) if it can't be told.
+    // With sniffing off the fallback is used as is and a BOM is kept as data
+    class ByteSource : public Source {
+    public:
+      explicit ByteSource(Encoding fallback = Encoding::CP1251, bool sniff = true):
+        m_next(nullptr),
+        m_end(nullptr),
+        m_last(false),
+        m_started(!sniff),
+        m_encoding(fallback),
+        m_position(0),
+        m_block(nullptr),
+        m_blocksize(0),
+        m_blockpos(0),
+        m_mapchars(0),
+        m_mapbytes(0)
+      {}
+
+      // Encoding of the data, only known for sure after the first read
+      Encoding encoding() const {
+        return m_encoding;
+      }
+
+      // Decodes whatever the current byte block holds, only asking for
+      // more bytes when nothing could be decoded. The buffer must have
+      // room for at least two characters
+      size_t read(wchar_t *buf, size_t cap) {
+        if (!m_started) {
+          start();
+        }
+        wchar_t *out = buf;
+        for (;;) {
+          const unsigned char *begin = m_next;
+          decode(m_encoding, m_next, m_end, out, buf + cap);
+          if (out != buf) {
+            new_block(begin);
+            return static_cast<size_t>(out - buf);
+          }
+          if (m_last) {
+            new_block(begin);
+            // Garbage at the end of the data
+            if (m_next != m_end) {
+              *out++ = REPLACEMENT_CHAR;
+              m_position += m_end - m_next;
+              m_next = m_end;
+            }
+            return static_cast<size_t>(out - buf);
+          }
+          more();
+        }
+      }
+
+      // Finds the byte offset of a character of the last read block by
+      // decoding the block again up to it. Going forward from the last
+      // asked position only decodes the bytes in between
+      long long offset(size_t pos) {
+        if (pos < m_mapchars) {
+          m_mapchars = m_mapbytes = 0;
+        }
+        wchar_t scratch[MAPBUF_CAP];
+        while (m_mapchars < pos) {
+          size_t want = pos - m_mapchars;
+          if (want > MAPBUF_CAP) {
+            want = MAPBUF_CAP;
+          }
+          const unsigned char *in = m_block + m_mapbytes;
+          wchar_t *out = scratch;
+          decode(m_encoding, in, m_block + m_blocksize, out, scratch + want);
+          if (out == scratch) {
+            break;
+          }
+          m_mapchars += static_cast<size_t>(out - scratch);
+          m_mapbytes += static_cast<size_t>(in - (m_block + m_mapbytes));
+        }
+        return static_cast<long long>(m_blockpos + m_mapbytes);
+      }
+
+      // Continues reading at a byte offset given by offset()
+      bool seek(long long pos) {
+        if (!m_started) {
+          start();
+        }
+        if (pos < 0 || !reposition(static_cast<unsigned long long>(pos))) {
+          return false;
+        }
+        m_position = static_cast<unsigned long long>(pos);
+        m_block = m_next;
+        m_blocksize = 0;
+        m_blockpos = m_position;
+        m_mapchars = m_mapbytes = 0;
+        return true;
+      }
+    protected:
+      // Bytes not decoded yet
+      const unsigned char *m_next;
+      const unsigned char *m_end;
+      // There are no more bytes after m_end
+      bool m_last;
+
+      // Makes more bytes available, keeping the undecoded ones in front
+      // of them. Sets m_last when the data is over
+      virtual void more() = 0;
+
+      // Makes the bytes from pos on the next ones to decode,
+      // sources that can't do that return false
+      virtual bool reposition(unsigned long long /*pos*/) {
+        return false;
+      }
+
+      // Restarts encoding detection, for sources that can be reopened
+      void restart(Encoding fallback) {
+        m_next = m_end = nullptr;
+        m_last = false;
+        m_started = false;
+        m_encoding = fallback;
+        m_position = 0;
+        m_block = nullptr;
+        m_blocksize = 0;
+        m_blockpos = 0;
+        m_mapchars = m_mapbytes = 0;
+      }
+    private:
+      static const size_t MAPBUF_CAP = 256;
+
+      bool m_started;
+      Encoding m_encoding;
+
+      // Byte offset of m_next in the data
+      unsigned long long m_position;
+
+      // Bytes decoded by the last read, where they start in the data,
+      // and the last character offset() mapped into them
+      const unsigned char *m_block;
+      size_t m_blocksize;
+      unsigned long long m_blockpos;
+      size_t m_mapchars;
+      size_t m_mapbytes;
+
+      void start() {
+        m_started = true;
+        while (!m_last && m_end - m_next < 3) {
+          more();
+        }
+        size_t bom = detect_bom(m_next, static_cast<size_t>(m_end - m_next), m_encoding);
+        if (bom == 0) {
+          size_t size = static_cast<size_t>(m_end - m_next);
+          if (size > SNIFF_SIZE) {
+            size = SNIFF_SIZE;
+          }
+          m_encoding = sniff_encoding(m_next, size, m_encoding);
+        }
+        m_next += bom;
+        m_position += bom;
+      }
+
+      void new_block(const unsigned char *begin) {
+        m_block = begin;
+        m_blocksize = static_cast<size_t>(m_next - begin);
+        m_blockpos = m_position;
+        m_mapchars = m_mapbytes = 0;
+        m_position += m_blocksize;
+      }
+    };
+
+    // Bytes already in memory, e.g. a mapped view of a file
+    class MemorySource : public ByteSource {
+    public:
+      MemorySource(const void *data, size_t size, Encoding fallback = Encoding::CP1251, bool sniff = true):
+        ByteSource(fallback, sniff),
+        m_data(static_cast<const unsigned char *>(data)),
+        m_size(size)
+      {
+        m_next = m_data;
+        m_end = m_data + size;
+        m_last = true;
+      }
+    protected:
+      void more() {
+        m_last = true;
+      }
+
+      bool reposition(unsigned long long pos) {
+        if (pos > m_size) {
+          return false;
+        }
+        m_next = m_data + pos;
+        m_end = m_data + m_size;
+        m_last = true;
+        return true;
+      }
+    private:
+      const unsigned char *m_data;
+      size_t m_size;
+    };
+
+#ifdef _WIN32
+    // File read in large blocks straight into the decoder
+    class FileSource : public ByteSource {
+    public:
+      FileSource():
+        m_file(INVALID_HANDLE_VALUE),
+        m_error(ERROR_SUCCESS),
+        m_buf(nullptr)
+      {}
+
+      ~FileSource() {
+        close();
+        delete[] m_buf;
+      }
+
+      // Opens the file for reading, returns false on failure
+      // leaving the reason in GetLastError()
+      bool open(const wchar_t *pathname, Encoding fallback = Encoding::CP1251) {
+        close();
+        restart(fallback);
+        m_error = ERROR_SUCCESS;
+        if (m_buf == nullptr) {
+          m_buf = new unsigned char[BYTEBUF_CAP];
+        }
+        m_file = ::CreateFileW(pathname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        return m_file != INVALID_HANDLE_VALUE;
+      }
+
+      bool is_open() const {
+        return m_file != INVALID_HANDLE_VALUE;
+      }
+
+      void close() {
+        if (m_file != INVALID_HANDLE_VALUE) {
+          ::CloseHandle(m_file);
+          m_file = INVALID_HANDLE_VALUE;
+        }
+      }
+
+      // Error that cut the data short, ERROR_SUCCESS if there was none
+      DWORD error() const {
+        return m_error;
+      }
+    protected:
+      void more() {
+        size_t left = static_cast<size_t>(m_end - m_next);
+        if (left != 0) {
+          memmove(m_buf, m_next, left);
+        }
+        DWORD got = 0;
+        if (m_file == INVALID_HANDLE_VALUE) {
+          m_error = ERROR_INVALID_HANDLE;
+        } else if (!::ReadFile(m_file, m_buf + left, static_cast<DWORD>(BYTEBUF_CAP - left), &got, NULL)) {
+          m_error = ::GetLastError();
+          got = 0;
+        }
+        m_next = m_buf;
+        m_end = m_buf + left + got;
+        if (got == 0) {
+          m_last = true;
+        }
+      }
+
+      bool reposition(unsigned long long pos) {
+        LARGE_INTEGER distance;
+        distance.QuadPart = static_cast<LONGLONG>(pos);
+        if (m_file == INVALID_HANDLE_VALUE || !::SetFilePointerEx(m_file, distance, NULL, FILE_BEGIN)) {
+          return false;
+        }
+        m_next = m_end = m_buf;
+        m_last = false;
+        return true;
+      }
+    private:
+      static const size_t BYTEBUF_CAP = 1024 * 256;
+
+      HANDLE m_file;
+      DWORD m_error;
+      unsigned char *m_buf;
+
+      FileSource(const FileSource&);
+      FileSource& operator=(const FileSource&);
+    };
+
+    // Whole file mapped into memory read-only, for parsers that need
+    // random access to the bytes
+    class MappedFile {
+    public:
+      MappedFile():
+        m_file(INVALID_HANDLE_VALUE),
+        m_mapping(NULL),
+        m_view(nullptr),
+        m_size(0)
+      {}
+
+      ~MappedFile() {
+        close();
+      }
+
+      // Maps the file, returns false on failure leaving
+      // the reason in GetLastError()
+      bool open(const wchar_t *pathname) {
+        close();
+        m_file = ::CreateFileW(pathname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE) {
+          return false;
+        }
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(m_file, &size)) {
+          close();
+          return false;
+        }
+        if (static_cast<unsigned long long>(size.QuadPart) > static_cast<size_t>(-1)) {
+          close();
+          ::SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+          return false;
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+        // Empty files can't be mapped, there's nothing to map anyway
+        if (m_size == 0) {
+          return true;
+        }
+        m_mapping = ::CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping != NULL) {
+          m_view = ::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (m_view == nullptr) {
+          DWORD err = ::GetLastError();
+          close();
+          ::SetLastError(err);
+          return false;
+        }
+        return true;
+      }
+
+      void close() {
+        if (m_view != nullptr) {
+          ::UnmapViewOfFile(m_view);
+          m_view = nullptr;
+        }
+        if (m_mapping != NULL) {
+          ::CloseHandle(m_mapping);
+          m_mapping = NULL;
+        }
+        if (m_file != INVALID_HANDLE_VALUE) {
+          ::CloseHandle(m_file);
+          m_file = INVALID_HANDLE_VALUE;
+        }
+        m_size = 0;
+      }
+
+      const void *data() const {
+        return m_view;
+      }
+
+      size_t size() const {
+        return m_size;
+      }
+    private:
+      HANDLE m_file;
+      HANDLE m_mapping;
+      const void *m_view;
+      size_t m_size;
+
+      MappedFile(const MappedFile&);
+      MappedFile& operator=(const MappedFile&);
+    };
+#endif
+  }
+}
+#endif
@@ -1,10 +1,187 @@
 #ifndef CSVWRITER_H
 #define CSVWRITER_H
-#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <typeinfo>
-#include <codecvt>
+#include <vector>
+
+#include "AsyncWriter.h"
+#include "numeric.h"
+#include "scan.h"
+
+// Writes text to a file as UTF-8. The text is encoded into a fixed size
+// buffer that goes to the file whenever it fills, so nothing but the
+// buffer is kept in memory however much is written. Given an AsyncWriter,
+// the full buffers are written on its thread instead
+class UTF8FileWriter
+{
+    public:
+        UTF8FileWriter(){
+            this->file = INVALID_HANDLE_VALUE;
+            this->used = 0;
+            this->error = ERROR_SUCCESS;
+            this->created = false;
+            this->async = NULL;
+        }
+
+        ~UTF8FileWriter(){
+            this->close();
+        }
+
+        // Creates the file, or opens it for appending. A new file
+        // starts with a byte order mark if bom is set
+        bool open(const wchar_t *filename, bool append, bool bom, AsyncWriter *async = NULL){
+            this->close();
+            this->file = CreateFileW(filename, append ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                     append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (this->file == INVALID_HANDLE_VALUE)
+                return false;
+            this->filename = filename;
+            this->created = !append || GetLastError() != ERROR_ALREADY_EXISTS;
+            this->error = ERROR_SUCCESS;
+            this->async = async;
+            this->buffer.resize(BUFFER_SIZE);
+            this->used = 0;
+            if (bom && this->created) {
+                this->buffer[0] = '\xEF';
+                this->buffer[1] = '\xBB';
+                this->buffer[2] = '\xBF';
+                this->used = 3;
+            }
+            return true;
+        }
+
+        bool isOpen() const {
+            return this->file != INVALID_HANDLE_VALUE;
+        }
+
+        void write(const std::wstring& str){
+            this->write(str.data(), str.size());
+        }
+
+        void write(const wchar_t *str, size_t len){
+            const wchar_t *end = str + len;
+            while (str != end) {
+                if (this->used > BUFFER_SIZE - 4)
+                    this->flush();
+                // Runs of ASCII go as they are
+                size_t room = BUFFER_SIZE - this->used;
+                char *out = &this->buffer[this->used];
+                char *outend = out + (room < (size_t)(end - str) ? room : (size_t)(end - str));
+                while (out != outend && (unsigned int)*str < 0x80)
+                    *out++ = (char)*str++;
+                this->used = (size_t)(out - &this->buffer[0]);
+                // The rest may need up to 4 bytes
+                if (str == end || this->used > BUFFER_SIZE - 4)
+                    continue;
+
+                unsigned int c = (unsigned int)*str++;
+                if (c >= 0xD800 && c <= 0xDBFF && str != end && (unsigned int)*str - 0xDC00 < 0x400)
+                    c = 0x10000 + ((c - 0xD800) << 10) + ((unsigned int)*str++ - 0xDC00);
+                else if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF)
+                    c = 0xFFFD; // not a character
+                if (c < 0x800) {
+                    *out++ = (char)(0xC0 | (c >> 6));
+                } else if (c < 0x10000) {
+                    *out++ = (char)(0xE0 | (c >> 12));
+                    *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+                } else {
+                    *out++ = (char)(0xF0 | (c >> 18));
+                    *out++ = (char)(0x80 | ((c >> 12) & 0x3F));
+                    *out++ = (char)(0x80 | ((c >> 6) & 0x3F));
+                }
+                *out++ = (char)(0x80 | (c & 0x3F));
+                this->used = (size_t)(out - &this->buffer[0]);
+            }
+        }
+
+        // Writes out what's left and closes the file. Returns false if any
+        // write failed, GetLastError() tells why
+        bool close(){
+            if (this->file == INVALID_HANDLE_VALUE)
+                return true;
+            if (this->async != NULL) {
+                this->error = this->closeAsync().get();
+                SetLastError(this->error);
+                return this->error == ERROR_SUCCESS;
+            }
+            this->flush();
+            if (!CloseHandle(this->file) && this->error == ERROR_SUCCESS)
+                this->error = GetLastError();
+            this->file = INVALID_HANDLE_VALUE;
+            std::vector<char>().swap(this->buffer);
+            SetLastError(this->error);
+            return this->error == ERROR_SUCCESS;
+        }
+
+        // Like close(), but does not wait for the AsyncWriter. The result
+        // comes with the future, and to done on the writer thread
+        std::future<DWORD> closeAsync(AsyncWriter::Callback done = AsyncWriter::Callback()){
+            if (this->async == NULL || this->file == INVALID_HANDLE_VALUE) {
+                DWORD error = this->close() ? ERROR_SUCCESS : GetLastError();
+                if (done)
+                    done(error);
+                std::promise<DWORD> result;
+                result.set_value(error);
+                return result.get_future();
+            }
+            this->flush();
+            std::future<DWORD> result = this->async->close(this->file, done);
+            this->file = INVALID_HANDLE_VALUE;
+            this->async = NULL;
+            std::vector<char>().swap(this->buffer);
+            return result;
+        }
+
+        // Closes the file, deleting it if it was created by open()
+        void discard(){
+            if (this->file == INVALID_HANDLE_VALUE)
+                return;
+            this->used = 0;
+            if (this->async != NULL)
+                this->async->close(this->file).wait();
+            else
+                CloseHandle(this->file);
+            this->async = NULL;
+            this->file = INVALID_HANDLE_VALUE;
+            std::vector<char>().swap(this->buffer);
+            if (this->created)
+                DeleteFileW(this->filename.c_str());
+        }
+    private:
+        static const size_t BUFFER_SIZE = 64 * 1024;
+
+        HANDLE file;
+        std::wstring filename;
+        std::vector<char> buffer;
+        size_t used;
+        DWORD error;
+        bool created;
+        AsyncWriter *async;
+
+        UTF8FileWriter(const UTF8FileWriter&);
+        UTF8FileWriter& operator=(const UTF8FileWriter&);
+
+        void flush(){
+            if (this->used == 0)
+                return;
+            if (this->async != NULL) {
+                this->async->write(this->file, this->buffer, this->used);
+                if (this->buffer.size() < BUFFER_SIZE)
+                    this->buffer.resize(BUFFER_SIZE);
+                this->used = 0;
+                return;
+            }
+            DWORD written = 0;
+            if (this->error == ERROR_SUCCESS &&
+                (!WriteFile(this->file, &this->buffer[0], (DWORD)this->used, &written, NULL) || written != this->used)) {
+                this->error = GetLastError();
+                if (this->error == ERROR_SUCCESS)
+                    this->error = ERROR_WRITE_FAULT;
+            }
+            this->used = 0;
+        }
+};
 
 class CSVWriter
 {
@@ -39,47 +216,76 @@ class CSVWriter
         }
 
         CSVWriter& add(const wchar_t *str){
-            return this->add(std::wstring(str));
+            return this->add(str, wcslen(str));
         }
 
         CSVWriter& add(wchar_t *str){
-            return this->add(std::wstring(str));
+            return this->add(str, wcslen(str));
         }
 
+#ifdef _WIN32
 		CSVWriter& add(_bstr_t str){
-            return this->add(std::wstring(str));
+            const wchar_t *data = str;
+            return data ? this->add(data, str.length()) : this->add(L"", 0);
         }
+#endif
 
-        CSVWriter& add(std::wstring str){
-            //if " character was found, escape it
-            size_t position = str.find(L"\"",0);
-            bool foundQuotationMarks = position != std::wstring::npos;
-            while(position != std::wstring::npos){
-                str.insert(position,L"\"");
-                position = str.find(L"\"",position + 2);
-            }
-            if(foundQuotationMarks){
-                str = L"\"" + str + L"\"";
-            }else if(str.find(this->seperator) != std::wstring::npos){
-                //if seperator was found and string was not escapted before, surround string with "
-                str = L"\"" + str + L"\"";
+        CSVWriter& add(const std::wstring& str){
+            return this->add(str.data(), str.size());
+        }
+
+        // Adds a text value. It is quoted only if it has a quote, the
+        // seperator or a line break in it, quotes inside are doubled
+        CSVWriter& add(const wchar_t *str, size_t len){
+            this->beginValue();
+            const wchar_t *end = str + len;
+            const wchar_t *special = this->findSpecial(str, end);
+            if(special == end){
+                this->put(str, len);
+            }else{
+                // Nothing before the first special character is a quote
+                this->put(L"\"", 1);
+                const wchar_t *run = str;
+                for(const wchar_t *quote = Scan::Find(special, end, L'"'); quote != end; quote = Scan::Find(quote + 1, end, L'"')){
+                    // The quote ends this run and starts the next one
+                    this->put(run, quote + 1 - run);
+                    run = quote;
+                }
+                this->put(run, end - run);
+                this->put(L"\"", 1);
             }
-            return this->add<std::wstring>(str);
+            this->valueCount++;
+            return *this;
+        }
+
+        // Numbers never depend on the locale, a double is written in the
+        // shortest form that reads back as the same value
+        CSVWriter& add(double value){
+            wchar_t buf[Numeric::FORMAT_BUFSIZE];
+            return this->addValue(buf, Numeric::FormatDouble(value, buf));
         }
 
+        // Integers of every type, so none of them goes to the stream
+        CSVWriter& add(short value){ return this->addSigned(value); }
+        CSVWriter& add(unsigned short value){ return this->addUnsigned(value); }
+        CSVWriter& add(int value){ return this->addSigned(value); }
+        CSVWriter& add(unsigned int value){ return this->addUnsigned(value); }
+        CSVWriter& add(long value){ return this->addSigned(value); }
+        CSVWriter& add(unsigned long value){ return this->addUnsigned(value); }
+        CSVWriter& add(long long value){ return this->addSigned(value); }
+        CSVWriter& add(unsigned long long value){ return this->addUnsigned(value); }
+
         template<typename T>
         CSVWriter& add(T str){
-            if(this->columnNum > -1){
-                //if autoNewRow is enabled, check if we need a line break
-                if(this->valueCount == this->columnNum ){
-                    this->newRow();
-                }
+            this->beginValue();
+            if(!this->sink.isOpen()){
+                this->ss << str;
+            }else{
+                std::wostringstream value;
+                value << str;
+                this->sink.write(value.str());
             }
-            if(valueCount > 0)
-                this->ss << this->seperator;
-            this->ss << str;
             this->valueCount++;
-
             return *this;
         }
 
@@ -89,20 +295,55 @@ class CSVWriter
         }
 
         void operator+=(CSVWriter &csv){
-            this->ss << std::endl << csv;
+            if(this->sink.isOpen()){
+                this->sink.write(L"\n", 1);
+                this->sink.write(csv.toString());
+            }else
+                this->ss << std::endl << csv;
         }
 
+        // Everything added so far, nothing when streaming to a file
         std::wstring toString(){
             return ss.str();
         }
 
+        // Streams the rows to a file from now on instead of keeping them,
+        // see UTF8FileWriter. A new file starts with a BOM, an appended one
+        // with a line break
+        bool open(const wchar_t *filename, bool append = false, AsyncWriter *async = NULL){
+            if(!this->sink.open(filename, append, true, async))
+                return false;
+            if(append)
+                this->sink.write(L"\n", 1);
+            return true;
+        }
+
+        // Finishes streaming, returns false if anything could not be written
+        bool close(){
+            return this->sink.close();
+        }
+
+        // Finishes streaming without waiting for an AsyncWriter to write
+        // the rest, see UTF8FileWriter::closeAsync()
+        std::future<DWORD> closeAsync(AsyncWriter::Callback done = AsyncWriter::Callback()){
+            return this->sink.closeAsync(done);
+        }
+
+        // Stops streaming and deletes the file open() created
+        void discard(){
+            this->sink.discard();
+        }
+
         friend std::wostream& operator<<(std::wostream& os, CSVWriter & csv){
             return os << csv.toString();
         }
 
         CSVWriter& newRow(){
             if(!this->firstRow || this->columnNum > -1){
-                ss << std::endl;
+                if(this->sink.isOpen())
+                    this->sink.write(L"\n", 1);
+                else
+                    ss << std::endl;
             }else{
                 //if the row is the first row, do not insert a new line
                 this->firstRow = false;
@@ -124,25 +365,13 @@ class CSVWriter
 		}
 
         bool writeToFile(const wchar_t *filename, bool append){
-            if (!append) {
-                // write BOM
-                std::ofstream file;
-                file.open(filename, std::ios::out | std::ios::trunc | std::ios::binary);
-                if (!file.is_open())
-                    return false;
-				file << (unsigned char)0xEF << (unsigned char)0xBB << (unsigned char)0xBF;
-				file.close();
-			}
-            std::wofstream file;
-            file.imbue(std::locale(std::locale(), new std::codecvt_utf8<wchar_t, 0x10ffff>));
-            file.open(filename, std::ios::out | std::ios::app | std::ios::binary );
-            if(!file.is_open())
+            UTF8FileWriter file;
+            if(!file.open(filename, append, true))
                 return false;
             if(append)
-                file << std::endl;
-            file << this->toString();
-            file.close();
-            return file.good();
+                file.write(L"\n", 1);
+            file.write(this->toString());
+            return file.close();
         }
 
         void enableAutoNewRow(int numberOfColumns){
@@ -158,6 +387,59 @@ class CSVWriter
         int columnNum;
         int valueCount;
         std::wstringstream ss;
+        UTF8FileWriter sink;
+
+        void beginValue(){
+            if(this->columnNum > -1){
+                //if autoNewRow is enabled, check if we need a line break
+                if(this->valueCount == this->columnNum ){
+                    this->newRow();
+                }
+            }
+            if(valueCount > 0)
+                this->put(this->seperator.data(), this->seperator.size());
+        }
+
+        CSVWriter& addValue(const wchar_t *str, size_t len){
+            this->beginValue();
+            this->put(str, len);
+            this->valueCount++;
+            return *this;
+        }
+
+        CSVWriter& addSigned(long long value){
+            wchar_t buf[Numeric::FORMAT_BUFSIZE];
+            return this->addValue(buf, Numeric::FormatInteger(value, buf));
+        }
+
+        CSVWriter& addUnsigned(unsigned long long value){
+            wchar_t buf[Numeric::FORMAT_BUFSIZE];
+            return this->addValue(buf, Numeric::FormatUnsigned(value, buf));
+        }
+
+        void put(const wchar_t *str, size_t len){
+            if(this->sink.isOpen())
+                this->sink.write(str, len);
+            else
+                this->ss.write(str, len);
+        }
+
+        // First quote, line break or seperator in the text, end if none
+        const wchar_t *findSpecial(const wchar_t *str, const wchar_t *end) const {
+            if(this->seperator.empty())
+                return Scan::FindAny(str, end, L'"', L'\r', L'\n');
+            wchar_t first = this->seperator[0];
+            size_t seplen = this->seperator.size();
+            for(;;){
+                const wchar_t *found = Scan::FindAny(str, end, L'"', L'\r', L'\n', first);
+                if(found == end || *found != first || seplen == 1)
+                    return found;
+                // Only a whole multi character seperator counts
+                if((size_t)(end - found) >= seplen && wmemcmp(found, this->seperator.data(), seplen) == 0)
+                    return found;
+                str = found + 1;
+            }
+        }
 
 };
 
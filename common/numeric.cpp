@@ -0,0 +1,524 @@
+#include "stdafx.h"
+#include <errno.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <string>
+
+#include "numeric.h"
+#include "pow5.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static _locale_t s_clocale = _create_locale(LC_NUMERIC, "C");
+#else
+static locale_t s_clocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+#endif
+
+// Exactly representable powers of ten
+static const double s_pow10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Anything the fast path can't do exactly goes to the CRT, with the
+// radix character pinned by the C locale
+static const wchar_t *ParseSlow( const wchar_t * str, const wchar_t * end, double & val )
+{
+	std::wstring buf(str, end);
+	const wchar_t *cstr = buf.c_str();
+	wchar_t *eptr;
+	errno = 0;
+#ifdef _MSC_VER
+	double v = _wcstod_l(cstr, &eptr, s_clocale);
+#else
+	double v = wcstod_l(cstr, &eptr, s_clocale);
+#endif
+	if ((errno == ERANGE) || (eptr == cstr))
+		return NULL;
+	val = v;
+	return str + (eptr - cstr);
+}
+
+// High 64 bits of a * b, the low ones in lo
+static inline unsigned long long MulHigh( unsigned long long a, unsigned long long b, unsigned long long & lo )
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long long hi;
+	lo = _umul128(a, b, &hi);
+	return hi;
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 p = (unsigned __int128)a * b;
+	lo = (unsigned long long)p;
+	return (unsigned long long)(p >> 64);
+#else
+	unsigned long long al = a & 0xFFFFFFFF, ah = a >> 32;
+	unsigned long long bl = b & 0xFFFFFFFF, bh = b >> 32;
+	unsigned long long ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	unsigned long long mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+	lo = (mid << 32) | (ll & 0xFFFFFFFF);
+	return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+// Leading zero bits of x != 0
+static inline int LeadingZeros( unsigned long long x )
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return 63 - (int)index;
+#elif defined(__GNUC__)
+	return __builtin_clzll(x);
+#else
+	int n = 0;
+	for (; (x & (1ULL << 63)) == 0; x <<= 1)
+		n++;
+	return n;
+#endif
+}
+
+// Eisel-Lemire (Daniel Lemire, "Number Parsing at a Gigabyte per Second",
+// 2021): the 19 digit mantissa times a 128 bit approximation of 5^exp10
+// gives the correctly rounded 53 bits of the result. Returns false for
+// anything that isn't a normal double, the CRT decides about underflow
+// and overflow then
+static bool EiselLemire( unsigned long long mantissa, int exp10, unsigned long long & bits )
+{
+	if ((exp10 < -342) || (exp10 > 308))
+		return false;
+
+	const int lz = LeadingZeros(mantissa);
+	mantissa <<= lz;
+	const unsigned long long *pow5 = s_pow5_128[exp10 + 342];
+	unsigned long long lo;
+	unsigned long long hi = MulHigh(mantissa, pow5[1], lo);
+	// The second half matters only when the low bits below the 55 kept are all ones
+	if ((hi & 0x1FF) == 0x1FF) {
+		unsigned long long lo2;
+		unsigned long long hi2 = MulHigh(mantissa, pow5[0], lo2);
+		lo += hi2;
+		if (hi2 > lo)
+			hi++;
+	}
+
+	const int upperbit = (int)(hi >> 63);
+	const int shift = upperbit + 9;
+	unsigned long long m = hi >> shift;
+	// floor(log2(10^exp10)) + 63 + 1023, see the paper
+	int e2 = (((152170 + 65536) * exp10) >> 16) + 63 + upperbit - lz + 1023;
+	if (e2 <= 0)
+		return false;
+
+	// A product exactly between two doubles rounds to even
+	if ((lo <= 1) && (exp10 >= -4) && (exp10 <= 23) && ((m & 3) == 1) && ((m << shift) == hi))
+		m &= ~1ULL;
+	m += m & 1;
+	m >>= 1;
+	if (m >= (2ULL << 52)) {
+		m = 1ULL << 52;
+		e2++;
+	}
+	if (e2 >= 0x7FF)
+		return false;
+
+	bits = (m & ((1ULL << 52) - 1)) | ((unsigned long long)e2 << 52);
+	return true;
+}
+
+// Parses the number at the start of [str, end), returns the position after it
+// or NULL. Up to 19 significant digits are gathered into an integer; when it
+// fits into the 53 bit mantissa and the power of ten is exact, a single
+// multiplication or division gives the correctly rounded result (Clinger),
+// otherwise Eisel-Lemire mostly does
+static const wchar_t *Parse( const wchar_t * str, const wchar_t * end, double & val )
+{
+	const wchar_t *p = str;
+	while ((p < end) && iswspace(*p))
+		p++;
+	const wchar_t *start = p;
+
+	bool neg = false;
+	if ((p < end) && ((*p == L'-') || (*p == L'+')))
+		neg = (*p++ == L'-');
+
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exp10 = 0;
+	bool any = false;
+	bool truncated = false;
+
+	// Leading zeros are not significant
+	while ((p < end) && (*p == L'0')) {
+		p++;
+		any = true;
+	}
+	// Hex numbers, infinity and nan are rare enough to leave to the CRT
+	if ((p < end) && !any && (*p != L'.') && ((unsigned)(*p - L'0') > 9))
+		return ParseSlow(start, end, val);
+	if (any && (p < end) && ((*p == L'x') || (*p == L'X')))
+		return ParseSlow(start, end, val);
+
+	for (; (p < end) && ((unsigned)(*p - L'0') <= 9); p++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - L'0');
+			digits++;
+		} else {
+			exp10++;
+			if (*p != L'0')
+				truncated = true;
+		}
+		any = true;
+	}
+	if ((p < end) && (*p == L'.')) {
+		p++;
+		if (digits == 0) {
+			for (; (p < end) && (*p == L'0'); p++) {
+				exp10--;
+				any = true;
+			}
+		}
+		for (; (p < end) && ((unsigned)(*p - L'0') <= 9); p++) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - L'0');
+				digits++;
+				exp10--;
+			} else if (*p != L'0')
+				truncated = true;
+			any = true;
+		}
+	}
+	if (!any)
+		return NULL;
+
+	if ((p < end) && ((*p == L'e') || (*p == L'E'))) {
+		const wchar_t *q = p + 1;
+		bool eneg = false;
+		if ((q < end) && ((*q == L'-') || (*q == L'+')))
+			eneg = (*q++ == L'-');
+		if ((q < end) && ((unsigned)(*q - L'0') <= 9)) {
+			int e = 0;
+			for (; (q < end) && ((unsigned)(*q - L'0') <= 9); q++) {
+				if (e < 100000)
+					e = e * 10 + (*q - L'0');
+			}
+			exp10 += eneg ? -e : e;
+			p = q;
+		}
+	}
+
+	if (mantissa == 0) {
+		val = neg ? -0.0 : 0.0;
+		return p;
+	}
+	double v;
+	if (!truncated && (mantissa <= (1ULL << 53)) && (exp10 >= -22) && (exp10 <= 22)) {
+		v = (double)mantissa;
+		if (exp10 < 0)
+			v /= s_pow10[-exp10];
+		else
+			v *= s_pow10[exp10];
+	} else {
+		// Digits dropped past the 19th put the value between mantissa and
+		// mantissa + 1, both have to round the same way
+		unsigned long long bits, upper;
+		if (!EiselLemire(mantissa, exp10, bits) ||
+			(truncated && (!EiselLemire(mantissa + 1, exp10, upper) || (upper != bits))))
+			return ParseSlow(start, end, val);
+		memcpy(&v, &bits, sizeof(v));
+	}
+	val = neg ? -v : v;
+	return p;
+}
+
+bool Numeric::ParseDouble( const wchar_t * str, const wchar_t * & endptr, double & val )
+{
+	// Only as far as a number can reach, so a long string of numbers isn't
+	// measured again for each of them. A letter other than the exponent may
+	// be part of a hex number, inf or nan, the whole rest is taken then
+	const wchar_t *end = str;
+	while (iswspace(*end))
+		end++;
+	for (wchar_t ch; ((unsigned)((ch = *end) - L'0') <= 9) || (ch == L'.') || (ch == L'e') || (ch == L'E') || (ch == L'-') || (ch == L'+'); )
+		end++;
+	if ((unsigned)((*end | 0x20) - L'a') < 26)
+		end += wcslen(end);
+
+	double v;
+	const wchar_t *eptr = Parse(str, end, v);
+	if (eptr == NULL)
+		return false;
+	val = v;
+	endptr = eptr;
+	return true;
+}
+
+bool Numeric::ParseDouble( const wchar_t * str, size_t len, double & val )
+{
+	const wchar_t *end = str + len;
+	double v;
+	const wchar_t *eptr = Parse(str, end, v);
+	if (eptr == NULL)
+		return false;
+	while ((eptr < end) && iswspace(*eptr))
+		eptr++;
+	if (eptr != end)
+		return false;
+	val = v;
+	return true;
+}
+
+// Shortest round trip formatting after Ryu (Ulf Adams, 2018). The binary
+// value and the halfway points to its neighbours are scaled by a power of
+// ten in 64 bit fixed point, then decimal digits are dropped while the
+// interval between the halfway points still tells the value apart
+
+// (m * mul) >> j for a 128 bit mul, j >= 64
+static inline unsigned long long MulShift( unsigned long long m, const unsigned long long * mul, int j )
+{
+	unsigned long long lo0, lo1;
+	unsigned long long hi0 = MulHigh(m, mul[0], lo0);
+	unsigned long long hi1 = MulHigh(m, mul[1], lo1);
+	unsigned long long sum = hi0 + lo1;
+	if (sum < hi0)
+		hi1++;
+	int shift = j - 64;
+	return shift == 0 ? sum : (hi1 << (64 - shift)) | (sum >> shift);
+}
+
+// ceil(log2(5^e)), 1 for e = 0
+static inline int Pow5Bits( int e )
+{
+	return (int)(((unsigned)e * 1217359) >> 19) + 1;
+}
+
+static inline int Log10Pow2( int e )
+{
+	return (int)(((unsigned)e * 78913) >> 18);
+}
+
+static inline int Log10Pow5( int e )
+{
+	return (int)(((unsigned)e * 732923) >> 20);
+}
+
+static inline bool MultipleOfPow5( unsigned long long value, int p )
+{
+	int count = 0;
+	for (; value % 5 == 0; value /= 5)
+		count++;
+	return count >= p;
+}
+
+static inline bool MultipleOfPow2( unsigned long long value, int p )
+{
+	return (value & ((1ULL << p) - 1)) == 0;
+}
+
+// Finds the shortest digits that read back as the double with the given
+// mantissa and biased exponent bits. The value is digits * 10^exp10
+static void ShortestDigits( unsigned long long ieeemantissa, int ieeeexponent, unsigned long long & digits, int & exp10 )
+{
+	int e2;
+	unsigned long long m2;
+	if (ieeeexponent == 0) {
+		e2 = 1 - 1023 - 52 - 2;
+		m2 = ieeemantissa;
+	} else {
+		e2 = ieeeexponent - 1023 - 52 - 2;
+		m2 = (1ULL << 52) | ieeemantissa;
+	}
+	const bool acceptbounds = (m2 & 1) == 0;
+	const unsigned long long mv = 4 * m2;
+	// The lower neighbour is closer when the mantissa is a power of two
+	const unsigned mmshift = (ieeemantissa != 0) || (ieeeexponent <= 1);
+
+	unsigned long long vr, vp, vm;
+	int e10;
+	bool vmtrailingzeros = false;
+	bool vrtrailingzeros = false;
+	if (e2 >= 0) {
+		const int q = Log10Pow2(e2) - (e2 > 3);
+		e10 = q;
+		const int k = 125 + Pow5Bits(q) - 1;
+		const int i = -e2 + q + k;
+		vr = MulShift(4 * m2, s_pow5invsplit[q], i);
+		vp = MulShift(4 * m2 + 2, s_pow5invsplit[q], i);
+		vm = MulShift(4 * m2 - 1 - mmshift, s_pow5invsplit[q], i);
+		if (q <= 21) {
+			// Only then can the scaled values be exact
+			if (mv % 5 == 0)
+				vrtrailingzeros = MultipleOfPow5(mv, q);
+			else if (acceptbounds)
+				vmtrailingzeros = MultipleOfPow5(mv - 1 - mmshift, q);
+			else
+				vp -= MultipleOfPow5(mv + 2, q);
+		}
+	} else {
+		const int q = Log10Pow5(-e2) - (-e2 > 1);
+		e10 = q + e2;
+		const int i = -e2 - q;
+		const int k = Pow5Bits(i) - 125;
+		const int j = q - k;
+		vr = MulShift(4 * m2, s_pow5split[i], j);
+		vp = MulShift(4 * m2 + 2, s_pow5split[i], j);
+		vm = MulShift(4 * m2 - 1 - mmshift, s_pow5split[i], j);
+		if (q <= 1) {
+			// mv has at least q trailing zero bits, so vr is exact
+			vrtrailingzeros = true;
+			if (acceptbounds)
+				vmtrailingzeros = mmshift == 1;
+			else
+				--vp;
+		} else if (q < 63) {
+			vrtrailingzeros = MultipleOfPow2(mv, q);
+		}
+	}
+
+	int removed = 0;
+	unsigned lastremoved = 0;
+	unsigned long long output;
+	if (vmtrailingzeros || vrtrailingzeros) {
+		// Rare: an exact value or bound needs the exact rounding rules
+		while (vp / 10 > vm / 10) {
+			vmtrailingzeros &= vm % 10 == 0;
+			vrtrailingzeros &= lastremoved == 0;
+			lastremoved = (unsigned)(vr % 10);
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		if (vmtrailingzeros) {
+			while (vm % 10 == 0) {
+				vrtrailingzeros &= lastremoved == 0;
+				lastremoved = (unsigned)(vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				removed++;
+			}
+		}
+		// Exactly halfway rounds to even
+		if (vrtrailingzeros && (lastremoved == 5) && (vr % 2 == 0))
+			lastremoved = 4;
+		output = vr + (((vr == vm) && (!acceptbounds || !vmtrailingzeros)) || (lastremoved >= 5));
+	} else {
+		bool roundup = false;
+		if (vp / 100 > vm / 100) {
+			// Two digits at a time most of the time
+			roundup = vr % 100 >= 50;
+			vr /= 100;
+			vp /= 100;
+			vm /= 100;
+			removed += 2;
+		}
+		while (vp / 10 > vm / 10) {
+			roundup = vr % 10 >= 5;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		output = vr + ((vr == vm) || roundup);
+	}
+	digits = output;
+	exp10 = e10 + removed;
+}
+
+size_t Numeric::FormatDouble( double val, wchar_t * buf )
+{
+	unsigned long long bits;
+	memcpy(&bits, &val, sizeof(bits));
+	const unsigned long long ieeemantissa = bits & ((1ULL << 52) - 1);
+	const int ieeeexponent = (int)((bits >> 52) & 0x7FF);
+	wchar_t *p = buf;
+	if (bits >> 63)
+		*p++ = L'-';
+
+	if (ieeeexponent == 0x7FF) {
+		// What wcstod reads back
+		if (ieeemantissa != 0)
+			p = buf;
+		const wchar_t *name = (ieeemantissa != 0) ? L"nan" : L"inf";
+		wmemcpy(p, name, 4);
+		return (size_t)(p + 3 - buf);
+	}
+	if ((ieeeexponent == 0) && (ieeemantissa == 0)) {
+		*p++ = L'0';
+		*p = L'\0';
+		return (size_t)(p - buf);
+	}
+
+	unsigned long long digits;
+	int exp10;
+	ShortestDigits(ieeemantissa, ieeeexponent, digits, exp10);
+
+	wchar_t text[20];
+	int len = 0;
+	for (unsigned long long d = digits; d != 0; d /= 10)
+		text[19 - len++] = (wchar_t)(L'0' + d % 10);
+	const wchar_t *first = text + 20 - len;
+	// Exponent of the leading digit
+	const int lead = exp10 + len - 1;
+
+	if ((lead < -4) || (lead >= 16)) {
+		// 1.2345e+25 as printf writes it
+		*p++ = first[0];
+		if (len > 1) {
+			*p++ = L'.';
+			wmemcpy(p, first + 1, len - 1);
+			p += len - 1;
+		}
+		*p++ = L'e';
+		*p++ = lead < 0 ? L'-' : L'+';
+		int e = lead < 0 ? -lead : lead;
+		if (e >= 100)
+			*p++ = (wchar_t)(L'0' + e / 100);
+		*p++ = (wchar_t)(L'0' + e / 10 % 10);
+		*p++ = (wchar_t)(L'0' + e % 10);
+	} else if (exp10 >= 0) {
+		wmemcpy(p, first, len);
+		p += len;
+		for (int i = 0; i < exp10; i++)
+			*p++ = L'0';
+	} else if (lead >= 0) {
+		wmemcpy(p, first, lead + 1);
+		p += lead + 1;
+		*p++ = L'.';
+		wmemcpy(p, first + lead + 1, len - lead - 1);
+		p += len - lead - 1;
+	} else {
+		*p++ = L'0';
+		*p++ = L'.';
+		for (int i = -1; i > lead; i--)
+			*p++ = L'0';
+		wmemcpy(p, first, len);
+		p += len;
+	}
+	*p = L'\0';
+	return (size_t)(p - buf);
+}
+
+size_t Numeric::FormatInteger( long long val, wchar_t * buf )
+{
+	if (val >= 0)
+		return FormatUnsigned((unsigned long long)val, buf);
+	*buf = L'-';
+	return FormatUnsigned(0 - (unsigned long long)val, buf + 1) + 1;
+}
+
+size_t Numeric::FormatUnsigned( unsigned long long val, wchar_t * buf )
+{
+	wchar_t text[20];
+	int len = 0;
+	do {
+		text[19 - len++] = (wchar_t)(L'0' + val % 10);
+		val /= 10;
+	} while (val != 0);
+	wmemcpy(buf, text + 20 - len, len);
+	buf[len] = L'\0';
+	return (size_t)len;
+}
@@ -0,0 +1,28 @@
+#ifndef _NUMERIC_H
+#define _NUMERIC_H
+
+#include <stddef.h>
+
+namespace Numeric {
+
+	// Decimal numbers with '.' as the radix character whatever the locale is.
+	// Leading white space is skipped as wcstod does. Fails when there is no
+	// number or it is out of range
+	bool ParseDouble( const wchar_t * str, const wchar_t * & endptr, double & val );
+	// Same for a string of len characters that doesn't have to be NUL
+	// terminated, all of it except surrounding white space must be the number
+	bool ParseDouble( const wchar_t * str, size_t len, double & val );
+
+	// Enough for any number FormatDouble or FormatInteger writes
+	const size_t FORMAT_BUFSIZE = 32;
+
+	// Shortest decimal text that ParseDouble reads back as exactly the same
+	// double, with '.' as the radix character. Scientific notation is used
+	// below 1e-4 and from 1e16 on, as in "1.5e-07". Returns the length
+	size_t FormatDouble( double val, wchar_t * buf );
+	size_t FormatInteger( long long val, wchar_t * buf );
+	size_t FormatUnsigned( unsigned long long val, wchar_t * buf );
+
+} /* Numeric */
+
+#endif /* _NUMERIC_H */
@@ -0,0 +1,141 @@
+#ifndef _POSIX_STDAFX_H
+#define _POSIX_STDAFX_H
+
+// Stand-in for the projects' precompiled header, so the platform independent
+// sources in common build and can be profiled on POSIX systems:
+//   c++ -O2 -I common/posix -c common/utilscore.cpp common/numeric.cpp common/posix/utils_posix.cpp
+// (link with -ldl for dladdr on older glibc), or see CMakeLists.txt here for
+// the tests and benchmarks. Only the Win32 types, calls and CRT extensions
+// those sources use are defined here, in terms of glibc
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	// wcsncasecmp, wcstod_l in numeric.cpp
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <locale.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef int BOOL;
+typedef int INT;
+typedef unsigned int UINT;
+typedef uint32_t DWORD;
+typedef size_t SIZE_T;
+typedef double DOUBLE;
+typedef wchar_t WCHAR;
+typedef wchar_t * LPWSTR;
+typedef const wchar_t * LPCWSTR;
+
+#define TRUE	1
+#define FALSE	0
+
+#define _countof(a)	(sizeof(a) / sizeof((a)[0]))
+#define _wcsnicmp	wcsncasecmp
+
+// Files for UTF8FileWriter and AsyncWriter (CSVWriter.h). A HANDLE is a file
+// descriptor, the last error is an errno value
+typedef void * HANDLE;
+
+#define INVALID_HANDLE_VALUE	((HANDLE)(intptr_t)-1)
+#define ERROR_SUCCESS			0
+#define ERROR_ALREADY_EXISTS	EEXIST
+#define ERROR_WRITE_FAULT		EIO
+
+#define GENERIC_WRITE			0x40000000
+#define FILE_APPEND_DATA		0x0004
+#define FILE_SHARE_READ			0x0001
+#define CREATE_ALWAYS			2
+#define OPEN_ALWAYS				4
+#define FILE_ATTRIBUTE_NORMAL	0x80
+
+static thread_local DWORD posix_lasterror = ERROR_SUCCESS;
+
+inline DWORD GetLastError()
+{
+	return posix_lasterror;
+}
+
+inline void SetLastError( DWORD error )
+{
+	posix_lasterror = error;
+}
+
+// paths are converted with the locale's multibyte encoding
+inline bool posix_path( const wchar_t * path, char * buf, size_t bufsz )
+{
+	size_t len = wcstombs(buf, path, bufsz);
+	if ((len == (size_t)-1) || (len == bufsz)) {
+		SetLastError(ENAMETOOLONG);
+		return false;
+	}
+	return true;
+}
+
+// Only what UTF8FileWriter asks for: writing, truncated or appended
+inline HANDLE CreateFileW( const wchar_t * filename, DWORD access, DWORD share, void * security,
+						   DWORD disposition, DWORD attributes, HANDLE templ )
+{
+	(void) share; (void) security; (void) attributes; (void) templ;
+	char path[4096];
+	if (!posix_path(filename, path, sizeof(path)))
+		return INVALID_HANDLE_VALUE;
+	struct stat st;
+	bool existed = stat(path, &st) == 0;
+	int flags = O_WRONLY | O_CREAT;
+	flags |= (access & FILE_APPEND_DATA) ? O_APPEND : 0;
+	flags |= (disposition == CREATE_ALWAYS) ? O_TRUNC : 0;
+	int fd = open(path, flags, 0666);
+	if (fd < 0) {
+		SetLastError(errno);
+		return INVALID_HANDLE_VALUE;
+	}
+	SetLastError(existed ? ERROR_ALREADY_EXISTS : ERROR_SUCCESS);
+	return (HANDLE)(intptr_t) fd;
+}
+
+inline BOOL WriteFile( HANDLE file, const void * data, DWORD size, DWORD * written, void * overlapped )
+{
+	(void) overlapped;
+	*written = 0;
+	while (*written < size) {
+		ssize_t ret = write((int)(intptr_t) file, (const char *) data + *written, size - *written);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			SetLastError(errno);
+			return FALSE;
+		}
+		*written += (DWORD) ret;
+	}
+	return TRUE;
+}
+
+inline BOOL CloseHandle( HANDLE file )
+{
+	if (close((int)(intptr_t) file) != 0) {
+		SetLastError(errno);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+inline BOOL DeleteFileW( const wchar_t * filename )
+{
+	char path[4096];
+	if (!posix_path(filename, path, sizeof(path)))
+		return FALSE;
+	if (unlink(path) != 0) {
+		SetLastError(errno);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+#endif /* _POSIX_STDAFX_H */
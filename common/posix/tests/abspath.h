@@ -0,0 +1,85 @@
+#ifndef _ABSPATH_H
+#define _ABSPATH_H
+
+// Utils::AbsPath as it was before CanonicalPath replaced it, kept for the
+// tests to compare with and for the benchmark to measure against. The one
+// change is a WCHAR more in the allocation, AbsPath wrote its terminator
+// past the end when the last token was kept
+
+#include "utils.h"
+
+namespace Legacy {
+
+	// what AbsPath returned, NULL for a bad path; delete[] it
+	inline LPWSTR AbsPath( LPCWSTR path, LPCWSTR reference, BOOL reflock = FALSE, WCHAR sareplacement = '_' )
+	{
+		if (Utils::IsPathRelative(reference))
+			return NULL;
+
+		SIZE_T pathlen = wcslen(path);
+		BOOL relp = Utils::IsPathRelative(path);
+		SIZE_T realsz = (relp?wcslen(reference):0) + pathlen + 2; // + separator + \0
+		LPWSTR real = new WCHAR[realsz + 1];
+		LPWSTR realroot = real;
+		LPWSTR realptr = real;
+		if (relp) {
+			wcscpy(real, reference);
+			if (!Utils::SanitizeFileSystemString(realptr, realsz - 1, sareplacement, FALSE, TRUE, &realroot)) {
+				delete[] real;
+				return NULL;
+			}
+			realptr += wcslen(real);
+			if (pathlen > 0) {
+				*realptr++ = '\\';
+				*realptr = '\0';
+			}
+			if (reflock)
+				realroot = realptr;
+			if (*path == '\\') { // relative to root
+				realptr = realroot;
+				path++;
+			}
+		}
+
+		SIZE_T pathsz = realsz - (realptr - real);
+		wcscpy(realptr, path);
+		if (!Utils::SanitizeFileSystemString(realptr, pathsz - 1, sareplacement, FALSE, TRUE, !relp?&realroot:NULL)) {
+			delete[] real;
+			return NULL;
+		}
+		realptr = realroot;
+		SIZE_T toklen = 0;
+		WCHAR ch;
+		for(LPWSTR pathptr = realroot; (ch = *pathptr) != '\0'; pathptr += toklen) {
+			if (ch == L'\\')
+				pathptr++;
+			toklen = wcscspn(pathptr, L"\\");
+			if (toklen == 0)
+				continue;
+			else if (*pathptr == L'.') {
+				if (toklen == 1)
+					continue;
+				if ((toklen == 2) && (pathptr[1] == L'.')) { // parent dir
+					INT count = 0;
+					while(realptr > realroot) {
+						realptr--;
+						if (*realptr == L'\\' && (++count > 1)) {
+							realptr++;
+							break;
+						}
+					}
+					continue;
+				}
+			}
+			if (realptr != pathptr)
+				wmemmove(realptr, pathptr, toklen + 1); // + separator or \0
+			realptr += toklen + 1;
+		}
+		*realptr = '\0';
+
+		return real;
+	}
+
+} /* Legacy */
+
+#endif /* _ABSPATH_H */
@@ -0,0 +1,37 @@
+#ifndef _ALLOCCOUNT_H
+#define _ALLOCCOUNT_H
+
+// Counts heap allocations by replacing the global operator new, which makes
+// it a header for one source file of a program only. Allocations() is the
+// number of them since the program started, on all threads
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+namespace AllocCount {
+
+	static std::atomic<unsigned long long> count(0);
+
+	inline unsigned long long Allocations()
+	{
+		return count.load();
+	}
+
+} /* AllocCount */
+
+void * operator new( size_t size )
+{
+	AllocCount::count++;
+	void * ptr = malloc(size != 0 ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete( void * ptr ) noexcept
+{
+	free(ptr);
+}
+
+#endif /* _ALLOCCOUNT_H */
@@ -0,0 +1,159 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+// Timing for the benchmark programs. A case is run a few times and the best
+// run is reported. Options, in any order:
+//   --quick           every case runs once on small inputs, that's how ctest
+//                     runs them to see they still work
+//   --save FILE       keeps the results for a later --check
+//   --check FILE      fails (exit code 1) on every case slower than saved
+//                     by more than the tolerance, or allocating more
+//   --tolerance PCT   for --check, 10 by default
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+	typedef struct {
+		double seconds;	// of the fastest run
+		double mbps;
+		double rowsps;
+		double allocs;	// per run, -1 if not counted
+	} RESULT;
+
+	static bool quick = false;
+	static const char * savepath = NULL;
+	static const char * checkpath = NULL;
+	static double tolerance = 10;
+
+	// counts heap allocations if the program sets it, see alloccount.h
+	static unsigned long long (*allocations)() = NULL;
+
+	// results go here so the work making them isn't optimized away
+	static volatile size_t sink;
+
+	static std::vector<std::pair<std::string, RESULT> > results;
+
+	// Returns the index of the first argument that isn't an option
+	inline int Init( int argc, char ** argv )
+	{
+		int i = 1;
+		for (; i < argc; i++) {
+			if (strcmp(argv[i], "--quick") == 0)
+				quick = true;
+			else if ((strcmp(argv[i], "--save") == 0) && (i + 1 < argc))
+				savepath = argv[++i];
+			else if ((strcmp(argv[i], "--check") == 0) && (i + 1 < argc))
+				checkpath = argv[++i];
+			else if ((strcmp(argv[i], "--tolerance") == 0) && (i + 1 < argc))
+				tolerance = atof(argv[++i]);
+			else
+				break;
+		}
+		return i;
+	}
+
+	inline double Now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Runs fn, which goes through bytes of input making rows of output,
+	// and prints the throughput of the fastest run
+	template<class Fn>
+	RESULT Measure( const char * name, size_t bytes, size_t rows, Fn fn )
+	{
+		// inputs that take seconds are not worth repeating
+		int runs = (quick || (bytes > 256 * 1024 * 1024)) ? 1 : 5;
+		RESULT res = { 0, 0, 0, -1 };
+		for (int run = 0; run < runs; run++) {
+			unsigned long long before = allocations ? allocations() : 0;
+			double start = Now();
+			fn();
+			double elapsed = Now() - start;
+			if (allocations)
+				res.allocs = (double) (allocations() - before);
+			if ((run == 0) || (elapsed < res.seconds))
+				res.seconds = elapsed;
+		}
+		if (res.seconds <= 0)
+			res.seconds = 1e-9;
+		res.mbps = bytes / res.seconds / 1e6;
+		res.rowsps = rows / res.seconds;
+		if (res.allocs >= 0)
+			printf("%-44s %10.1f MB/s %12.0f rows/s %12.0f allocs\n", name, res.mbps, res.rowsps, res.allocs);
+		else
+			printf("%-44s %10.1f MB/s %12.0f rows/s\n", name, res.mbps, res.rowsps);
+		fflush(stdout);
+		results.push_back(std::make_pair(std::string(name), res));
+		return res;
+	}
+
+	// One "name<TAB>MB/s<TAB>allocs" line per result
+	inline bool Save( const char * path )
+	{
+		FILE * file = fopen(path, "w");
+		if (file == NULL)
+			return false;
+		for (size_t i = 0; i < results.size(); i++)
+			fprintf(file, "%s\t%.3f\t%.0f\n", results[i].first.c_str(), results[i].second.mbps, results[i].second.allocs);
+		return fclose(file) == 0;
+	}
+
+	// Compares the results with the saved ones, returns the number of
+	// regressions. Cases that are not in the file are not compared
+	inline int Check( const char * path )
+	{
+		FILE * file = fopen(path, "r");
+		if (file == NULL) {
+			fprintf(stderr, "can't read %s\n", path);
+			return 1;
+		}
+		int regressions = 0;
+		char line[512];
+		while (fgets(line, sizeof(line), file) != NULL) {
+			char * tab = strchr(line, '\t');
+			if (tab == NULL)
+				continue;
+			*tab = '\0';
+			double mbps = 0, allocs = -1;
+			if (sscanf(tab + 1, "%lf\t%lf", &mbps, &allocs) < 1)
+				continue;
+			for (size_t i = 0; i < results.size(); i++) {
+				if (results[i].first != line)
+					continue;
+				const RESULT & res = results[i].second;
+				if (res.mbps < mbps * (1 - tolerance / 100)) {
+					fprintf(stderr, "%s: %.1f MB/s, was %.1f\n", line, res.mbps, mbps);
+					regressions++;
+				}
+				if ((allocs >= 0) && (res.allocs > allocs * (1 + tolerance / 100))) {
+					fprintf(stderr, "%s: %.0f allocations, was %.0f\n", line, res.allocs, allocs);
+					regressions++;
+				}
+			}
+		}
+		fclose(file);
+		return regressions;
+	}
+
+	// What main() returns, after --save and --check
+	inline int Finish()
+	{
+		if ((savepath != NULL) && !Save(savepath)) {
+			fprintf(stderr, "can't write %s\n", savepath);
+			return 1;
+		}
+		if ((checkpath != NULL) && (Check(checkpath) != 0))
+			return 1;
+		return 0;
+	}
+
+} /* Bench */
+
+#endif /* _BENCH_H */
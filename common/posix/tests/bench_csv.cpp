@@ -0,0 +1,152 @@
+// CsvParser and CSVWriter throughput on generated corpora (see corpus.h):
+// short, long and heavily quoted fields, CRLF and LF, UTF-8 and UTF-16,
+// from 1 KB up to the size given (64M by default, 1G at most):
+//   bench_csv [--quick] [--save FILE] [--check FILE] [--tolerance PCT] [SIZE[K|M|G]]
+
+#include "stdafx.h"
+#include "CSVWriter.h"
+#include "alloccount.h"
+#include "bench.h"
+#include "corpus.h"
+
+using namespace aria::csv;
+
+static const size_t KB = 1024;
+static const size_t MB = 1024 * KB;
+static const size_t GB = 1024 * MB;
+
+static size_t parse_size(const char *arg) {
+  char *end;
+  double size = strtod(arg, &end);
+  switch (*end) {
+    case 'k': case 'K': size *= KB; break;
+    case 'm': case 'M': size *= MB; break;
+    case 'g': case 'G': size *= GB; break;
+  }
+  return size > GB ? GB : static_cast<size_t>(size);
+}
+
+static std::string size_name(size_t size) {
+  char buf[32];
+  if (size >= GB) {
+    snprintf(buf, sizeof(buf), "%zuG", size / GB);
+  } else if (size >= MB) {
+    snprintf(buf, sizeof(buf), "%zuM", size / MB);
+  } else {
+    snprintf(buf, sizeof(buf), "%zuK", size / KB);
+  }
+  return buf;
+}
+
+static void bench_parse(const Corpus::SHAPE& shape, size_t size) {
+  size_t rows;
+  std::string data = Corpus::Make(shape, size, rows);
+  std::string name = "parse " + Corpus::Name(shape) + " " + size_name(size);
+  Bench::Measure(name.c_str(), data.size(), rows, [&]() {
+    MemorySource source(data.data(), data.size());
+    CsvParser parser(source);
+    parser.delimiter(L';');
+    size_t chars = 0;
+    for (auto& row : parser) {
+      for (size_t i = 0; i < row.size(); i++) {
+        chars += row[i].size;
+      }
+    }
+    Bench::sink = chars;
+  });
+}
+
+// Writes rows cycling through the sample until size bytes of UTF-8
+static size_t write_rows(CSVWriter& csv, const std::vector<std::vector<std::wstring> >& sample,
+                         const std::vector<size_t>& bytes, size_t size) {
+  size_t written = 0;
+  size_t rows = 0;
+  for (; written < size; rows++) {
+    const std::vector<std::wstring>& fields = sample[rows % sample.size()];
+    csv.newRow();
+    for (size_t i = 0; i < fields.size(); i++) {
+      csv.add(fields[i]);
+    }
+    written += bytes[rows % sample.size()];
+  }
+  return rows;
+}
+
+static void bench_write(Corpus::FIELDS fields, size_t size, const std::string& path) {
+  Corpus::SHAPE shape = { fields, false, Encoding::UTF8 };
+  std::vector<std::vector<std::wstring> > sample(1000);
+  std::vector<size_t> bytes(sample.size());
+  for (size_t i = 0; i < sample.size(); i++) {
+    Corpus::Row(shape, static_cast<unsigned int>(i), sample[i]);
+    std::wstring text;
+    std::string data;
+    Corpus::Append(shape, sample[i], text);
+    Corpus::Encode(shape, text, data);
+    bytes[i] = data.size();
+  }
+  size_t rows = 0;
+  size_t total = 0;
+  while (total < size) {
+    total += bytes[rows++ % sample.size()];
+  }
+
+  std::string suffix = std::string(Corpus::FieldsName(fields)) + " " + size_name(size);
+  std::wstring wpath(path.begin(), path.end());
+  // A gigabyte of wide characters is too much to keep
+  if (size <= 64 * MB) {
+    Bench::Measure(("write memory " + suffix).c_str(), total, rows, [&]() {
+      CSVWriter csv;
+      write_rows(csv, sample, bytes, size);
+      Bench::sink = csv.toString().size();
+    });
+  }
+  Bench::Measure(("write file " + suffix).c_str(), total, rows, [&]() {
+    CSVWriter csv;
+    if (!csv.open(wpath.c_str())) {
+      fprintf(stderr, "can't create %s\n", path.c_str());
+      exit(1);
+    }
+    Bench::sink = write_rows(csv, sample, bytes, size);
+    csv.close();
+  });
+  AsyncWriter writer;
+  Bench::Measure(("write file async " + suffix).c_str(), total, rows, [&]() {
+    CSVWriter csv;
+    if (!csv.open(wpath.c_str(), false, &writer)) {
+      fprintf(stderr, "can't create %s\n", path.c_str());
+      exit(1);
+    }
+    Bench::sink = write_rows(csv, sample, bytes, size);
+    csv.close();
+  });
+  writer.shutdown();
+}
+
+int main(int argc, char **argv) {
+  int arg = Bench::Init(argc, argv);
+  Bench::allocations = AllocCount::Allocations;
+  size_t largest = Bench::quick ? 64 * KB : 64 * MB;
+  if (arg < argc) {
+    largest = parse_size(argv[arg]);
+  }
+  static const size_t sizes[] = { KB, 64 * KB, MB, 64 * MB, GB };
+  const char *tmp = getenv("TMPDIR");
+  std::string path = std::string(tmp != NULL ? tmp : "/tmp") + "/bench_csv.csv";
+
+  for (int fields = Corpus::F_SHORT; fields <= Corpus::F_QUOTED; fields++) {
+    for (int crlf = 1; crlf >= 0; crlf--) {
+      for (int utf16 = 0; utf16 < 2; utf16++) {
+        Corpus::SHAPE shape = { static_cast<Corpus::FIELDS>(fields), crlf != 0,
+                                utf16 ? Encoding::UTF16LE : Encoding::UTF8 };
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && sizes[i] <= largest; i++) {
+          bench_parse(shape, sizes[i]);
+        }
+      }
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && sizes[i] <= largest; i++) {
+      bench_write(static_cast<Corpus::FIELDS>(fields), sizes[i], path);
+    }
+  }
+  remove(path.c_str());
+  return Bench::Finish();
+}
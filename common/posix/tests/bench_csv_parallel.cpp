@@ -0,0 +1,59 @@
+// How ParallelParser scales with the number of threads, against the
+// CsvParser iterator on one thread
+
+#include <thread>
+
+#include "CSVParallel.h"
+#include "bench.h"
+
+using namespace aria::csv;
+
+static std::string corpus(size_t size, size_t& rows) {
+  std::string data;
+  rows = 0;
+  while (data.size() < size) {
+    data += "Length_";
+    data += std::to_string(rows);
+    data += ";";
+    data += std::to_string(rows * 7 % 1000);
+    data += ".5;\"comment; with \"\"quotes\"\"\r\nand a line break\";plain text field\r\n";
+    rows++;
+  }
+  return data;
+}
+
+int main(int argc, char **argv) {
+  Bench::Init(argc, argv);
+  size_t rows;
+  std::string data = corpus(Bench::quick ? 4 * 1024 * 1024 : 256 * 1024 * 1024, rows);
+  unsigned int cores = std::thread::hardware_concurrency();
+  printf("%zu bytes, %zu rows, %u cores\n", data.size(), rows, cores);
+
+  // Making the same rows as ParallelParser::parse() does
+  Bench::RESULT single = Bench::Measure("CsvParser iterator", data.size(), rows, [&]() {
+    MemorySource source(data.data(), data.size());
+    CsvParser parser(source);
+    parser.delimiter(L';');
+    CSV all;
+    for (auto& row : parser) {
+      all.push_back(row.strings());
+    }
+    Bench::sink = all.size();
+  });
+
+  // Past the cores too, to see what oversubscribing costs
+  unsigned int most = cores > 4 ? cores : 4;
+  for (unsigned int threads = 1; threads <= most; threads *= 2) {
+    char name[64];
+    size_t chunks = 0;
+    snprintf(name, sizeof(name), "ParallelParser, %u thread(s)", threads);
+    Bench::RESULT res = Bench::Measure(name, data.size(), rows, [&]() {
+      ParallelParser parser(data.data(), data.size());
+      parser.delimiter(L';').threads(threads);
+      Bench::sink = parser.parse().size();
+      chunks = parser.chunks();
+    });
+    printf("%-44s %10zu chunks %8.2fx\n", "", chunks, single.seconds / res.seconds);
+  }
+  return Bench::Finish();
+}
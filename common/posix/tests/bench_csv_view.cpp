@@ -0,0 +1,106 @@
+// next_field() copying every field against next_field_view(), on fields that
+// can be viewed in place and on fields with escaped quotes that can't
+
+#include <sstream>
+
+#include "CSVParser.h"
+#include "bench.h"
+
+using namespace aria::csv;
+
+// The whole text at once, in place
+class TextSource : public Source {
+public:
+  explicit TextSource(const std::wstring& text): m_text(text), m_done(false) {}
+
+  size_t read(wchar_t *buf, size_t cap) {
+    const wchar_t *data;
+    size_t n = fetch(data, buf, cap);
+    wmemcpy(buf, data, n);
+    return n;
+  }
+
+  size_t fetch(const wchar_t *&data, wchar_t * /*buf*/, size_t /*cap*/) {
+    data = m_text.data();
+    size_t n = m_done ? 0 : m_text.size();
+    m_done = true;
+    return n;
+  }
+private:
+  const std::wstring& m_text;
+  bool m_done;
+};
+
+static std::wstring corpus(size_t size, bool escaped, size_t& rows) {
+  std::wstring text;
+  rows = 0;
+  while (text.size() < size) {
+    text += L"Variable_";
+    text += static_cast<wchar_t>(L'0' + rows % 10);
+    text += escaped ? L";\"12.5 \"\"mm\"\"\";\"comment, \"\"quoted\"\"\"\r\n" : L";12.5;plain comment text\r\n";
+    rows++;
+  }
+  return text;
+}
+
+static size_t copy_fields(CsvParser& parser) {
+  CSV rows;
+  std::vector<std::wstring> row;
+  for (;;) {
+    Field field = parser.next_field();
+    if (field.type == FieldType::DATA) {
+      row.push_back(*field.data);
+    } else if (field.type == FieldType::ROW_END) {
+      rows.push_back(std::move(row));
+      row.clear();
+    } else {
+      break;
+    }
+  }
+  return rows.size();
+}
+
+static size_t view_fields(CsvParser& parser) {
+  size_t chars = 0;
+  for (;;) {
+    FieldView field = parser.next_field_view();
+    if (field.type == FieldType::DATA) {
+      chars += field.size;
+    } else if (field.type != FieldType::ROW_END) {
+      break;
+    }
+  }
+  return chars;
+}
+
+int main(int argc, char **argv) {
+  Bench::Init(argc, argv);
+  size_t size = Bench::quick ? 64 * 1024 : 64 * 1024 * 1024;
+
+  for (int escaped = 0; escaped < 2; escaped++) {
+    size_t rows;
+    std::wstring text = corpus(size, escaped != 0, rows);
+    size_t bytes = text.size() * sizeof(wchar_t);
+    printf("%s fields, %zu rows\n", escaped ? "escaped" : "plain", rows);
+
+    Bench::Measure("next_field, rows of strings", bytes, rows, [&]() {
+      std::wistringstream stream(text);
+      CsvParser parser(stream);
+      parser.delimiter(L';');
+      Bench::sink = copy_fields(parser);
+    });
+    Bench::Measure("next_field_view, stream", bytes, rows, [&]() {
+      std::wistringstream stream(text);
+      CsvParser parser(stream);
+      parser.delimiter(L';');
+      Bench::sink = view_fields(parser);
+    });
+    Bench::Measure("next_field_view, in place", bytes, rows, [&]() {
+      TextSource source(text);
+      CsvParser parser(source);
+      parser.delimiter(L';');
+      Bench::sink = view_fields(parser);
+    });
+  }
+  return Bench::Finish();
+}
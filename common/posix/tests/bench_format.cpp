@@ -0,0 +1,99 @@
+// Numeric::FormatDouble and FormatInteger against what they replaced: the
+// wide stream of CSVWriter::add<T> and the "%g" of CString::AppendFormat
+
+#include "stdafx.h"
+#include <sstream>
+#include <vector>
+
+#include "numeric.h"
+#include "bench.h"
+
+static std::vector<double> doubles(size_t count) {
+  // Variable values as they come: round numbers, decimals, fractions
+  std::vector<double> values(count);
+  unsigned int seed = 7;
+  for (size_t i = 0; i < count; i++) {
+    seed = seed * 1103515245u + 12345u;
+    switch (i % 4) {
+      case 0: values[i] = static_cast<double>(seed >> 22); break;
+      case 1: values[i] = (seed >> 16) / 10.0; break;
+      case 2: values[i] = (seed >> 8) / 3.0; break;
+      default: values[i] = -1.0 / ((seed >> 20) + 1); break;
+    }
+  }
+  return values;
+}
+
+int main(int argc, char **argv) {
+  Bench::Init(argc, argv);
+  size_t count = Bench::quick ? 10000 : 2000000;
+  std::vector<double> values = doubles(count);
+  size_t bytes = count * sizeof(double);
+  wchar_t buf[64];
+
+  printf("%zu doubles\n", count);
+  Bench::Measure("double: Numeric::FormatDouble", bytes, count, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+      len += Numeric::FormatDouble(values[i], buf);
+    }
+    Bench::sink = len;
+  });
+  Bench::Measure("double: swprintf %g (loses digits)", bytes, count, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+      len += swprintf(buf, 64, L"%g", values[i]);
+    }
+    Bench::sink = len;
+  });
+  Bench::Measure("double: swprintf %.17g", bytes, count, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+      len += swprintf(buf, 64, L"%.17g", values[i]);
+    }
+    Bench::sink = len;
+  });
+  Bench::Measure("double: wostringstream per value", bytes, count, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+      std::wostringstream value;
+      value << values[i];
+      len += value.str().size();
+    }
+    Bench::sink = len;
+  });
+  Bench::Measure("double: wstringstream shared", bytes, count, [&]() {
+    std::wstringstream ss;
+    for (size_t i = 0; i < count; i++) {
+      ss << values[i] << L';';
+    }
+    Bench::sink = ss.str().size();
+  });
+
+  printf("%zu integers\n", count);
+  bytes = count * sizeof(long long);
+  Bench::Measure("integer: Numeric::FormatInteger", bytes, count, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+      len += Numeric::FormatInteger(static_cast<long long>(values[i] * 1000), buf);
+    }
+    Bench::sink = len;
+  });
+  Bench::Measure("integer: swprintf %lld", bytes, count, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+      len += swprintf(buf, 64, L"%lld", static_cast<long long>(values[i] * 1000));
+    }
+    Bench::sink = len;
+  });
+  Bench::Measure("integer: wostringstream per value", bytes, count, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+      std::wostringstream value;
+      value << static_cast<long long>(values[i] * 1000);
+      len += value.str().size();
+    }
+    Bench::sink = len;
+  });
+  return Bench::Finish();
+}
@@ -0,0 +1,62 @@
+// Utils::CanonicalPath against the AbsPath it replaced, on the typical
+// ComposeDir inputs of pathcases.h and on the whole table
+
+#include "stdafx.h"
+#include <vector>
+
+#include "abspath.h"
+#include "pathcases.h"
+#include "alloccount.h"
+#include "bench.h"
+
+static void bench_cases(const char *name, const std::vector<const PathCases::CASE *>& cases, size_t calls) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < calls; i++) {
+    const PathCases::CASE& c = *cases[i % cases.size()];
+    bytes += (wcslen(c.path) + wcslen(c.reference)) * sizeof(WCHAR);
+  }
+
+  std::string title = std::string("CanonicalPath ") + name;
+  Bench::Measure(title.c_str(), bytes, calls, [&]() {
+    // the stack buffer ComposeDir gives it
+    WCHAR buf[260];
+    size_t len = 0;
+    for (size_t i = 0; i < calls; i++) {
+      const PathCases::CASE& c = *cases[i % cases.size()];
+      len += Utils::CanonicalPath(c.path, c.reference, buf, _countof(buf), NULL, c.reflock);
+    }
+    Bench::sink = len;
+  });
+  title = std::string("AbsPath ") + name;
+  Bench::Measure(title.c_str(), bytes, calls, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < calls; i++) {
+      const PathCases::CASE& c = *cases[i % cases.size()];
+      LPWSTR real = Legacy::AbsPath(c.path, c.reference, c.reflock);
+      if (real != NULL) {
+        len += wcslen(real);
+        delete[] real;
+      }
+    }
+    Bench::sink = len;
+  });
+}
+
+int main(int argc, char **argv) {
+  Bench::Init(argc, argv);
+  Bench::allocations = AllocCount::Allocations;
+  size_t calls = Bench::quick ? 10000 : 2000000;
+
+  std::vector<const PathCases::CASE *> typical, all;
+  for (size_t i = 0; i < _countof(PathCases::cases); i++) {
+    if (PathCases::cases[i].typical) {
+      typical.push_back(&PathCases::cases[i]);
+    }
+    all.push_back(&PathCases::cases[i]);
+  }
+
+  printf("%zu calls\n", calls);
+  bench_cases("typical", typical, calls);
+  bench_cases("table", all, calls);
+  return Bench::Finish();
+}
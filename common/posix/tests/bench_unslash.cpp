@@ -0,0 +1,60 @@
+// Utils::UnSlash against the decoder it replaced, on comments and names
+// as templates have them. Each run restores the input first, the copy is
+// in the times of both
+
+#include "stdafx.h"
+#include <string>
+#include <vector>
+
+#include "unslash.h"
+#include "alloccount.h"
+#include "bench.h"
+
+// size characters with an escape every period of them
+static std::wstring text(size_t size, size_t period, const wchar_t *escape) {
+  static const wchar_t words[] = L"\x0414\x043B\x0438\x043D\x0430 length of the M8 bolt, ";
+  std::wstring text;
+  while (text.size() < size) {
+    size_t run = period - wcslen(escape);
+    for (size_t i = 0; i < run && text.size() < size; i++) {
+      text += words[(text.size() + i) % (_countof(words) - 1)];
+    }
+    text += escape;
+  }
+  text.resize(size);
+  if (text[size - 1] == L'\\') {
+    text[size - 1] = L'.';
+  }
+  return text;
+}
+
+template<class Fn>
+static void bench_text(const char *name, const std::wstring& source, size_t calls, Fn unslash) {
+  std::vector<WCHAR> buf(source.size() + 1);
+  Bench::Measure(name, calls * source.size() * sizeof(WCHAR), calls, [&]() {
+    size_t len = 0;
+    for (size_t i = 0; i < calls; i++) {
+      wmemcpy(&buf[0], source.c_str(), source.size() + 1);
+      len += unslash(&buf[0]);
+    }
+    Bench::sink = len;
+  });
+}
+
+static void bench_case(const char *name, size_t size, size_t period, const wchar_t *escape, size_t calls) {
+  std::wstring source = text(size, period, escape);
+  bench_text((std::string("UnSlash ") + name).c_str(), source, calls, Utils::UnSlash);
+  bench_text((std::string("legacy UnSlash ") + name).c_str(), source, calls, Legacy::UnSlash);
+}
+
+int main(int argc, char **argv) {
+  Bench::Init(argc, argv);
+  Bench::allocations = AllocCount::Allocations;
+  size_t chars = Bench::quick ? 1000000 : 500000000;
+
+  bench_case("511 chars, \\n every 57", 511, 57, L"\\n", chars / 511);
+  bench_case("64K chars, \\n every 57", 65536, 57, L"\\n", chars / 65536);
+  bench_case("512 chars, escape every 3", 512, 3, L"\\t", chars / 512);
+  bench_case("512 chars, \\u every 12", 512, 12, L"\\u0431", chars / 512);
+  return Bench::Finish();
+}
@@ -0,0 +1,22 @@
+#ifndef _CHECK_H
+#define _CHECK_H
+
+// Checks for the test programs. A failed CHECK prints where it is and the
+// program goes on, main() returns CHECK_RESULT() to tell ctest about it
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			check_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_RESULT() \
+	(check_failures == 0 ? 0 : (fprintf(stderr, "%d check(s) failed\n", check_failures), 1))
+
+#endif /* _CHECK_H */
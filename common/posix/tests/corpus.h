@@ -0,0 +1,131 @@
+#ifndef _CORPUS_H
+#define _CORPUS_H
+
+// Generated CSV for the benchmarks. The same shape always makes the same
+// rows, so results of different builds can be compared
+
+#include <string>
+#include <vector>
+
+#include "CSVSource.h"
+
+namespace Corpus {
+
+	enum FIELDS {
+		F_SHORT,	// a few characters, numbers mostly
+		F_LONG,		// a hundred and more, with non-ASCII text
+		F_QUOTED	// delimiters, quotes and line breaks inside
+	};
+
+	typedef struct {
+		FIELDS fields;
+		bool crlf;
+		aria::csv::Encoding encoding;	// UTF8 or UTF16LE, both with a BOM
+	} SHAPE;
+
+	inline const char * FieldsName( FIELDS fields )
+	{
+		static const char * names[] = { "short", "long", "quoted" };
+		return names[fields];
+	}
+
+	inline std::string Name( const SHAPE & shape )
+	{
+		std::string name(FieldsName(shape.fields));
+		name += shape.crlf ? " CRLF " : " LF ";
+		name += shape.encoding == aria::csv::Encoding::UTF8 ? "UTF-8" : "UTF-16";
+		return name;
+	}
+
+	// Fields of a row, the same for the same row number
+	inline void Row( const SHAPE & shape, unsigned int row, std::vector<std::wstring> & fields )
+	{
+		static const wchar_t text[] = L"\x0414\x043B\x0438\x043D\x0430 length of the \x0431\x043E\x043B\x0442 M8 ";
+		unsigned int seed = row * 2654435761u;
+		fields.resize(shape.fields == F_SHORT ? 8 : 4);
+		for (size_t i = 0; i < fields.size(); i++) {
+			seed = seed * 1103515245u + 12345u;
+			std::wstring & field = fields[i];
+			field.clear();
+			switch (shape.fields) {
+			case F_SHORT:
+				field = std::to_wstring(seed >> 20);
+				if (i % 2)
+					field += L".5";
+				break;
+			case F_LONG:
+				for (size_t len = 100 + (seed >> 24); field.size() < len; )
+					field += text;
+				break;
+			case F_QUOTED:
+				field = L"a \"quoted\" value; ";
+				field += std::to_wstring(seed >> 16);
+				if (i % 2)
+					field += L"\r\nsecond line";
+				break;
+			}
+		}
+	}
+
+	// Appends a row as CSV with ';' as the delimiter
+	inline void Append( const SHAPE & shape, const std::vector<std::wstring> & fields, std::wstring & text )
+	{
+		for (size_t i = 0; i < fields.size(); i++) {
+			const std::wstring & field = fields[i];
+			if (i > 0)
+				text += L';';
+			if (field.find_first_of(L";\"\r\n") == std::wstring::npos) {
+				text += field;
+				continue;
+			}
+			text += L'"';
+			for (size_t c = 0; c < field.size(); c++) {
+				text += field[c];
+				if (field[c] == L'"')
+					text += L'"';
+			}
+			text += L'"';
+		}
+		text += shape.crlf ? L"\r\n" : L"\n";
+	}
+
+	// BMP characters only, that's all Row makes
+	inline void Encode( const SHAPE & shape, const std::wstring & text, std::string & data )
+	{
+		for (size_t i = 0; i < text.size(); i++) {
+			unsigned int c = (unsigned int) text[i];
+			if (shape.encoding == aria::csv::Encoding::UTF16LE) {
+				data += (char) (c & 0xFF);
+				data += (char) (c >> 8);
+			} else if (c < 0x80) {
+				data += (char) c;
+			} else if (c < 0x800) {
+				data += (char) (0xC0 | (c >> 6));
+				data += (char) (0x80 | (c & 0x3F));
+			} else {
+				data += (char) (0xE0 | (c >> 12));
+				data += (char) (0x80 | ((c >> 6) & 0x3F));
+				data += (char) (0x80 | (c & 0x3F));
+			}
+		}
+	}
+
+	// At least size bytes of whole rows, rows tells how many
+	inline std::string Make( const SHAPE & shape, size_t size, size_t & rows )
+	{
+		std::string data(shape.encoding == aria::csv::Encoding::UTF16LE ? "\xFF\xFE" : "\xEF\xBB\xBF");
+		data.reserve(size + 4096);
+		std::vector<std::wstring> fields;
+		std::wstring text;
+		for (rows = 0; data.size() < size; rows++) {
+			Row(shape, (unsigned int) rows, fields);
+			text.clear();
+			Append(shape, fields, text);
+			Encode(shape, text, data);
+		}
+		return data;
+	}
+
+} /* Corpus */
+
+#endif /* _CORPUS_H */
@@ -0,0 +1,91 @@
+// Once the CsvParser iterator has seen the widest row, parsing any number
+// of rows more allocates nothing
+
+#include "CSVSource.h"
+#include "alloccount.h"
+#include "check.h"
+
+using namespace aria::csv;
+
+static std::string corpus() {
+  // The widest row first, the rest are narrower but varied, with escaped
+  // quotes and line breaks that go through the field buffer, and longer
+  // than the input buffer so it's refilled a few times
+  std::string data("first;\"widest \"\"row\"\" of them all\";");
+  data += std::string(900, 'w');
+  data += ";1;2;3;4;5;6;7;8;9\r\n";
+  for (unsigned int row = 0; data.size() < 2 * 1024 * 1024; row++) {
+    data += "name";
+    data += std::to_string(row);
+    switch (row % 3) {
+      case 0:
+        data += ";12.5\r\n";
+        break;
+      case 1:
+        data += ";\"a \"\"quoted\"\"\r\nvalue\";x;y\n";
+        break;
+      default:
+        data += ";" + std::string(row % 200, 'v') + ";\xC6\xE5\r\n";
+    }
+  }
+  return data;
+}
+
+static void test_steady_state() {
+  std::string data = corpus();
+  MemorySource source(data.data(), data.size());
+  CsvParser parser(source);
+  parser.delimiter(L';');
+
+  CsvParser::iterator it = parser.begin();
+  CHECK(it != parser.end() && it->size() == 12);
+  unsigned long long before = AllocCount::Allocations();
+  size_t rows = 1;
+  size_t chars = 0;
+  for (++it; it != parser.end(); ++it) {
+    for (size_t i = 0; i < it->size(); i++) {
+      chars += (*it)[i].size;
+    }
+    rows++;
+  }
+  unsigned long long allocs = AllocCount::Allocations() - before;
+  CHECK(rows > 30000 && chars > 0);
+  if (allocs != 0) {
+    fprintf(stderr, "%llu allocations in %zu rows\n", allocs, rows);
+  }
+  CHECK(allocs == 0);
+}
+
+static void test_row_growth() {
+  // A row wider than all before grows the storage once, not per row
+  std::string data;
+  for (int i = 0; i < 100; i++) {
+    data += "a;b\n";
+  }
+  data += "a;b;c;d;e;f;g;h;i;j;k;l;m;n;o;p\n";
+  for (int i = 0; i < 100; i++) {
+    data += "a;b;c;d;e;f;g;h;i;j;k;l;m;n;o;p\n";
+  }
+  MemorySource source(data.data(), data.size());
+  CsvParser parser(source);
+  parser.delimiter(L';');
+  // begin() reads the first row
+  CsvParser::iterator it = parser.begin();
+  for (int i = 1; i < 100; i++) {
+    ++it;
+  }
+  unsigned long long before = AllocCount::Allocations();
+  ++it;
+  CHECK(it->size() == 16);
+  unsigned long long grown = AllocCount::Allocations() - before;
+  for (++it; it != parser.end(); ++it) {
+  }
+  CHECK(grown > 0);
+  CHECK(AllocCount::Allocations() - before == grown);
+}
+
+int main() {
+  test_steady_state();
+  test_row_growth();
+  return CHECK_RESULT();
+}
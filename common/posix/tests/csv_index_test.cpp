@@ -0,0 +1,254 @@
+// RowIndex moves a parser to any row of UTF-8 (malformed bytes and
+// characters past the BMP included), UTF-16 and CP1251 data, read at once
+// or in small blocks, and reads the same row full iteration does. A saved
+// index loads back the same and refuses a wrong stamp or damaged data
+
+#include <sstream>
+#include <stdlib.h>
+
+#include "CSVSource.h"
+#include "CSVIndex.h"
+#include "check.h"
+
+using namespace aria::csv;
+
+// Hands the bytes out a few at a time, to cross every kind of character
+// at a block boundary, and can seek like FileSource
+class BlockSource : public ByteSource {
+public:
+  BlockSource(const std::string& data, size_t block):
+    m_data(data), m_blocksize(block), m_pos(0) {}
+protected:
+  void more() {
+    std::string left;
+    if (m_next != nullptr) {
+      left.assign(reinterpret_cast<const char *>(m_next), m_end - m_next);
+    }
+    size_t n = m_data.size() - m_pos;
+    if (n > m_blocksize) {
+      n = m_blocksize;
+    }
+    m_buf = left + m_data.substr(m_pos, n);
+    m_pos += n;
+    m_next = reinterpret_cast<const unsigned char *>(m_buf.data());
+    m_end = m_next + m_buf.size();
+    if (m_pos == m_data.size()) {
+      m_last = true;
+    }
+  }
+
+  bool reposition(unsigned long long pos) {
+    if (pos > m_data.size()) {
+      return false;
+    }
+    m_pos = static_cast<size_t>(pos);
+    m_buf.clear();
+    m_next = m_end = reinterpret_cast<const unsigned char *>(m_buf.data());
+    m_last = false;
+    return true;
+  }
+private:
+  const std::string& m_data;
+  size_t m_blocksize;
+  size_t m_pos;
+  std::string m_buf;
+};
+
+static void encode(Encoding encoding, const std::wstring& text, std::string& data) {
+  for (size_t i = 0; i < text.size(); i++) {
+    unsigned int c = static_cast<unsigned int>(text[i]);
+    if (encoding == Encoding::CP1251) {
+      // ASCII and the Cyrillic alphabet are all the generator makes for it
+      data += static_cast<char>(c < 0x80 ? c : c - 0x410 + 0xC0);
+    } else if (encoding == Encoding::UTF16LE) {
+      if (c > 0xFFFF) {
+        c -= 0x10000;
+        unsigned int hi = 0xD800 + (c >> 10);
+        data += static_cast<char>(hi & 0xFF);
+        data += static_cast<char>(hi >> 8);
+        c = 0xDC00 + (c & 0x3FF);
+      }
+      data += static_cast<char>(c & 0xFF);
+      data += static_cast<char>(c >> 8);
+    } else if (c < 0x80) {
+      data += static_cast<char>(c);
+    } else if (c < 0x800) {
+      data += static_cast<char>(0xC0 | (c >> 6));
+      data += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+      data += static_cast<char>(0xE0 | (c >> 12));
+      data += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      data += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+      data += static_cast<char>(0xF0 | (c >> 18));
+      data += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+      data += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      data += static_cast<char>(0x80 | (c & 0x3F));
+    }
+  }
+}
+
+// Rows of plain, Cyrillic and quoted fields with delimiters, quotes and
+// line breaks inside, CRLF and LF, now and then an empty line
+static std::string corpus(Encoding encoding, bool terminated) {
+  std::string data;
+  if (encoding == Encoding::UTF8) {
+    data = "\xEF\xBB\xBF";
+  } else if (encoding == Encoding::UTF16LE) {
+    data = "\xFF\xFE";
+  }
+  unsigned int seed = 11;
+  for (int row = 0; row < 300; row++) {
+    seed = seed * 1103515245u + 12345u;
+    int fields = 1 + (seed >> 16) % 5;
+    for (int f = 0; f < fields; f++) {
+      std::wstring field;
+      switch ((seed >> (f * 3)) % 5) {
+        case 0:
+          field = L"plain" + std::to_wstring(row);
+          break;
+        case 1:
+          field = L"\x0414\x043B\x0438\x043D\x0430 \x0431\x043E\x043B\x0442\x0430";
+          break;
+        case 2:
+          field = L"\"quoted, \"\"twice\"\"\r\nand on\"";
+          break;
+        case 3:
+          field = L"\"\"";
+          break;
+        default:
+          field = std::wstring(row % 40, L'x');
+      }
+      if (f > 0) {
+        data += ',';
+      }
+      encode(encoding, field, data);
+      if (f == 1 && encoding == Encoding::UTF8) {
+        // broken sequences and a character past the BMP
+        data += row % 2 ? "\xFF" : "\xE2\x82";
+        encode(encoding, std::wstring(1, static_cast<wchar_t>(0x1F600)), data);
+      } else if (f == 1 && encoding == Encoding::UTF16LE) {
+        encode(encoding, std::wstring(1, static_cast<wchar_t>(0x1F600)), data);
+      }
+    }
+    if (row + 1 < 300 || terminated) {
+      encode(encoding, row % 3 ? L"\r\n" : L"\n", data);
+    }
+    if (row % 37 == 5) {
+      encode(encoding, L"\n", data);
+    }
+  }
+  return data;
+}
+
+// The next row, false at the end of the data
+static bool read_row(CsvParser& parser, std::vector<std::wstring>& row) {
+  row.clear();
+  for (;;) {
+    FieldView field = parser.next_field_view();
+    if (field.type == FieldType::DATA) {
+      row.push_back(field.str());
+    } else if (field.type == FieldType::ROW_END) {
+      return true;
+    } else {
+      return !row.empty();
+    }
+  }
+}
+
+// Seeks to every row, in a jumping order, and reads it
+static bool seeks_match(const RowIndex& index, CsvParser& parser, const CSV& rows) {
+  std::vector<std::wstring> row;
+  size_t count = rows.size() + 1;
+  for (size_t i = 0; i < count; i++) {
+    size_t k = (i * 7919) % count;
+    if (!index.seek(parser, k)) {
+      fprintf(stderr, "can't seek to row %zu of %zu\n", k, rows.size());
+      return false;
+    }
+    bool more = read_row(parser, row);
+    if (k == rows.size() ? more : (!more || row != rows[k])) {
+      fprintf(stderr, "row %zu of %zu reads differently after a seek\n", k, rows.size());
+      return false;
+    }
+  }
+  return true;
+}
+
+static void test_seek(Encoding encoding, bool terminated, size_t block) {
+  std::string data = corpus(encoding, terminated);
+  CSV rows;
+  {
+    MemorySource source(data.data(), data.size());
+    CsvParser parser(source);
+    std::vector<std::wstring> row;
+    while (read_row(parser, row)) {
+      rows.push_back(row);
+    }
+  }
+
+  static const size_t everies[] = { 1, 3, 16, 1000 };
+  for (size_t e = 0; e < sizeof(everies) / sizeof(everies[0]); e++) {
+    MemorySource memory(data.data(), data.size());
+    BlockSource blocks(data, block);
+    ByteSource& source = block != 0 ? static_cast<ByteSource&>(blocks) : memory;
+    CsvParser parser(source);
+    RowIndex index(everies[e]);
+    CHECK(index.build(parser));
+    CHECK(index.rows() == rows.size());
+    CHECK(seeks_match(index, parser, rows));
+    CHECK(!index.seek(parser, rows.size() + 1));
+  }
+}
+
+static void test_save_load() {
+  std::string data = corpus(Encoding::UTF8, false);
+  CSV rows;
+  {
+    MemorySource source(data.data(), data.size());
+    CsvParser parser(source);
+    std::vector<std::wstring> row;
+    while (read_row(parser, row)) {
+      rows.push_back(row);
+    }
+  }
+
+  MemorySource source(data.data(), data.size());
+  CsvParser parser(source);
+  RowIndex index(10);
+  CHECK(index.build(parser));
+  std::stringstream saved;
+  CHECK(index.save(saved, 42));
+  std::string sidecar = saved.str();
+
+  RowIndex loaded;
+  std::istringstream in(sidecar);
+  CHECK(loaded.load(in, 42));
+  CHECK(loaded.every() == 10 && loaded.rows() == index.rows());
+  CHECK(seeks_match(loaded, parser, rows));
+
+  // another stamp, cut short, damaged
+  RowIndex stale;
+  std::istringstream wrongstamp(sidecar);
+  CHECK(!stale.load(wrongstamp, 43));
+  std::istringstream cut(sidecar.substr(0, sidecar.size() - 3));
+  CHECK(!stale.load(cut, 42));
+  std::string damaged(sidecar);
+  damaged[0] ^= 0x20;
+  std::istringstream badmagic(damaged);
+  CHECK(!stale.load(badmagic, 42));
+  CHECK(stale.empty());
+}
+
+int main() {
+  static const Encoding encodings[] = { Encoding::UTF8, Encoding::UTF16LE, Encoding::CP1251 };
+  static const size_t blocks[] = { 0, 1, 7, 4096 };
+  for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+      test_seek(encodings[e], true, blocks[b]);
+      test_seek(encodings[e], false, blocks[b]);
+    }
+  }
+  test_save_load();
+  return CHECK_RESULT();
+}
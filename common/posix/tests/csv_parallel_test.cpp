@@ -0,0 +1,120 @@
+// ParallelParser gives the same rows as the CsvParser iterator over the same
+// bytes, however the chunks fall
+
+#include <stdlib.h>
+
+#include "CSVParallel.h"
+#include "check.h"
+
+using namespace aria::csv;
+
+static CSV parse_sequential(const std::string& data, wchar_t delimiter) {
+  MemorySource source(data.data(), data.size());
+  CsvParser parser(source);
+  parser.delimiter(delimiter);
+  CSV rows;
+  for (auto& row : parser) {
+    rows.push_back(row.strings());
+  }
+  return rows;
+}
+
+static void check_same(const std::string& data, wchar_t delimiter, bool split) {
+  CSV expected = parse_sequential(data, delimiter);
+  CHECK(!expected.empty());
+  for (unsigned int threads = 1; threads <= 8; threads *= 2) {
+    ParallelParser parser(data.data(), data.size());
+    parser.delimiter(delimiter).threads(threads);
+    CHECK(parser.parse() == expected);
+    if (split && threads > 1) {
+      CHECK(parser.chunks() > 1);
+    }
+  }
+}
+
+// Rows of quoted fields with delimiters, quotes and line breaks inside,
+// so the chunk boundaries land inside quoted runs too
+static std::string quoted_corpus(size_t size) {
+  std::string data;
+  for (unsigned int row = 0; data.size() < size; row++) {
+    data += "name";
+    data += std::to_string(row);
+    data += ";\"a;b\"\"c\"\"\r\nd\";";
+    data += std::string(rand() % 40, 'x');
+    data += ";\"\xC6\xE5\"\r\n";
+  }
+  return data;
+}
+
+static void test_quoted() {
+  srand(4);
+  check_same(quoted_corpus(5 * 1024 * 1024), L';', true);
+}
+
+static void test_utf16() {
+  // UTF-16LE with a BOM, every chunk has to be cut on a code unit
+  std::string narrow = quoted_corpus(3 * 1024 * 1024);
+  std::string data("\xFF\xFE", 2);
+  for (size_t i = 0; i < narrow.size(); i++) {
+    data += narrow[i];
+    data += '\0';
+  }
+  check_same(data, L';', true);
+}
+
+static void test_sniffed() {
+  // No BOM, the sequential parser sniffs UTF-8 from the first block and
+  // every chunk has to be decoded the same way
+  std::string data;
+  for (unsigned int row = 0; data.size() < 3 * 1024 * 1024; row++) {
+    data += "\xD0\x94\xD0\xBB\xD0\xB8\xD0\xBD\xD0\xB0_";
+    data += std::to_string(row);
+    data += ";\"\xD0\xBA\xD0\xBE\xD0\xBC\xD0\xBC\xD0\xB5\xD0\xBD\xD1\x82\r\n\";12.5\r\n";
+  }
+  ParallelParser parser(data.data(), data.size());
+  CHECK(parser.encoding() == Encoding::UTF8);
+  check_same(data, L';', true);
+  CSV rows = parse_sequential(data, L';');
+  CHECK(!rows.empty() && rows[0][0] == L"\x0414\x043B\x0438\x043D\x0430_0");
+
+  // UTF-16LE without a BOM is told by its zero bytes
+  std::string wide;
+  for (size_t i = 0; wide.size() < 3 * 1024 * 1024; i++) {
+    const char *row = i % 2 ? "a;\"b\r\nc\";d\r\n" : "e;f;g\n";
+    for (; *row != '\0'; row++) {
+      wide += *row;
+      wide += '\0';
+    }
+  }
+  ParallelParser wparser(wide.data(), wide.size());
+  CHECK(wparser.encoding() == Encoding::UTF16LE);
+  check_same(wide, L';', true);
+}
+
+static void test_stray_quotes() {
+  // Quotes inside unquoted fields throw the quote counting off,
+  // the rows still have to come out the same
+  std::string data;
+  for (unsigned int row = 0; data.size() < 3 * 1024 * 1024; row++) {
+    data += row % 7 == 0 ? "5\" pipe,x\n" : "a,\"b\nc\",d\n";
+  }
+  check_same(data, L',', false);
+}
+
+static void test_small() {
+  // Too small to split, one chunk
+  std::string data("a,b\n\"c\nd\",e\n");
+  ParallelParser parser(data.data(), data.size());
+  parser.threads(4);
+  CHECK(parser.parse() == parse_sequential(data, L','));
+  CHECK(parser.chunks() == 1);
+}
+
+int main() {
+  test_quoted();
+  test_utf16();
+  test_sniffed();
+  test_stray_quotes();
+  test_small();
+  return CHECK_RESULT();
+}
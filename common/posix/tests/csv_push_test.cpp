@@ -0,0 +1,66 @@
+// PushParser: rows come out as soon as they are terminated, whatever is
+// split between pieces is carried over
+
+#include "CSVPush.h"
+#include "check.h"
+
+using namespace aria::csv;
+
+static CSV rows;
+
+static void collect(const Row& row) {
+  rows.push_back(row.strings());
+}
+
+static void test_row_on_terminator() {
+  rows.clear();
+  PushParser parser(collect);
+  parser.feed(L"a,b\n", 4);
+  // No need to see what follows the '\n'
+  CHECK(rows.size() == 1);
+  parser.feed(L"c,d\r", 4);
+  CHECK(rows.size() == 2);
+  // The '\n' of that "\r\n" comes late, it makes no empty row
+  parser.feed(L"\ne", 2);
+  CHECK(rows.size() == 2);
+  parser.finish();
+  CHECK(rows.size() == 3);
+  CHECK(rows.size() == 3 && rows[1][1] == L"d" && rows[2].size() == 1 && rows[2][0] == L"e");
+}
+
+static void test_split_fields() {
+  rows.clear();
+  PushParser parser(collect);
+  // A quoted field with a line break and an escaped quote, cut everywhere
+  const wchar_t text[] = L"x,\"a\r\nb\"\"c\",y\r\nz\n";
+  for (size_t i = 0; text[i] != L'\0'; i++) {
+    parser.feed(text + i, 1);
+  }
+  CHECK(rows.size() == 2);
+  parser.finish();
+  CHECK(rows.size() == 2);
+  CHECK(rows.size() == 2 && rows[0].size() == 3 && rows[0][1] == L"a\r\nb\"c" && rows[0][2] == L"y");
+  CHECK(rows.size() == 2 && rows[1].size() == 1 && rows[1][0] == L"z");
+}
+
+static void test_bytes() {
+  rows.clear();
+  PushParser parser(collect);
+  // UTF-8 with a BOM, the BOM and a two byte character are both split
+  const char text[] = "\xEF\xBB\xBF\xD0\x96;1\n";
+  parser.delimiter(L';');
+  for (size_t i = 0; text[i] != '\0'; i++) {
+    parser.feed_bytes(text + i, 1);
+  }
+  CHECK(parser.encoding() == Encoding::UTF8);
+  CHECK(rows.size() == 1 && rows[0].size() == 2 && rows[0][0] == L"\x0416" && rows[0][1] == L"1");
+  parser.finish();
+  CHECK(rows.size() == 1);
+}
+
+int main() {
+  test_row_on_terminator();
+  test_split_fields();
+  test_bytes();
+  return CHECK_RESULT();
+}
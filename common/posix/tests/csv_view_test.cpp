@@ -0,0 +1,212 @@
+// CsvParser::next_field_view(): fields point into the input unless they
+// have to be unescaped or cross a refill, and read the same either way
+
+#define ARIA_CSV_STATS
+#include <sstream>
+#include <stdlib.h>
+
+#include "CSVParser.h"
+#include "check.h"
+
+using namespace aria::csv;
+
+// Hands the text out in pieces of the given sizes, in place
+class PieceSource : public Source {
+public:
+  PieceSource(const std::wstring& text, const std::vector<size_t>& pieces):
+    m_text(text), m_pieces(pieces), m_pos(0), m_piece(0) {}
+
+  size_t read(wchar_t *buf, size_t cap) {
+    const wchar_t *data;
+    size_t n = fetch(data, buf, cap);
+    wmemcpy(buf, data, n);
+    return n;
+  }
+
+  size_t fetch(const wchar_t *&data, wchar_t * /*buf*/, size_t cap) {
+    size_t n = m_text.size() - m_pos;
+    if (m_piece < m_pieces.size() && m_pieces[m_piece] < n) {
+      n = m_pieces[m_piece];
+    }
+    if (n > cap) {
+      n = cap;
+    }
+    m_piece++;
+    data = m_text.data() + m_pos;
+    m_pos += n;
+    return n;
+  }
+
+  bool inside(const FieldView& field) const {
+    return field.data >= m_text.data() && field.data + field.size <= m_text.data() + m_text.size();
+  }
+private:
+  const std::wstring& m_text;
+  std::vector<size_t> m_pieces;
+  size_t m_pos;
+  size_t m_piece;
+};
+
+static CSV parse_views(CsvParser& parser) {
+  CSV rows;
+  std::vector<std::wstring> row;
+  for (;;) {
+    FieldView field = parser.next_field_view();
+    if (field.type == FieldType::DATA) {
+      row.push_back(field.str());
+    } else if (field.type == FieldType::ROW_END) {
+      rows.push_back(row);
+      row.clear();
+    } else {
+      break;
+    }
+  }
+  if (!row.empty()) {
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+static CSV parse_fields(CsvParser& parser) {
+  CSV rows;
+  std::vector<std::wstring> row;
+  for (;;) {
+    Field field = parser.next_field();
+    if (field.type == FieldType::DATA) {
+      row.push_back(*field.data);
+    } else if (field.type == FieldType::ROW_END) {
+      rows.push_back(row);
+      row.clear();
+    } else {
+      break;
+    }
+  }
+  if (!row.empty()) {
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+static void test_in_place() {
+  std::wstring text(L"ab,cd\r\n\"q,1\",\"e\"\"x\"\n");
+  PieceSource source(text, std::vector<size_t>());
+  CsvParser parser(source);
+
+  FieldView f = parser.next_field_view();
+  CHECK(f.type == FieldType::DATA && f.str() == L"ab" && source.inside(f));
+  f = parser.next_field_view();
+  CHECK(f.type == FieldType::DATA && f.str() == L"cd" && source.inside(f));
+  CHECK(parser.next_field_view().type == FieldType::ROW_END);
+  // Quoted without escapes is still a plain run
+  f = parser.next_field_view();
+  CHECK(f.type == FieldType::DATA && f.str() == L"q,1" && source.inside(f));
+  // An escaped quote has to be dropped, so the field is a copy
+  f = parser.next_field_view();
+  CHECK(f.type == FieldType::DATA && f.str() == L"e\"x" && !source.inside(f));
+  // The end of the last row is the end of the data
+  CHECK(parser.next_field_view().type == FieldType::CSV_END);
+  CHECK(parser.stats().fields == 4 && parser.stats().copied == 1);
+}
+
+static void test_refill() {
+  // A field split by the end of a piece is put together in the field buffer
+  std::wstring text(L"ab,cd\n\"ef\ngh\",ij\n");
+  std::vector<size_t> pieces;
+  pieces.push_back(4);
+  pieces.push_back(6);
+  PieceSource source(text, pieces);
+  CsvParser parser(source);
+  CSV rows = parse_views(parser);
+  CHECK(rows.size() == 2);
+  CHECK(rows.size() == 2 && rows[0].size() == 2 && rows[0][1] == L"cd");
+  CHECK(rows.size() == 2 && rows[1].size() == 2 && rows[1][0] == L"ef\ngh" && rows[1][1] == L"ij");
+  CHECK(parser.stats().copied == 2);
+
+  // The same across a refill of the parser's own input buffer
+  std::wstring big(128 * 1024 - 3, L'x');
+  big += L",\"y\"\"";
+  big += std::wstring(10, L'z');
+  big += L"\"\nlast";
+  std::wistringstream stream(big);
+  CsvParser sparser(stream);
+  rows = parse_fields(sparser);
+  CHECK(rows.size() == 2);
+  CHECK(rows.size() == 2 && rows[0].size() == 2 && rows[0][0].size() == 128 * 1024 - 3);
+  CHECK(rows.size() == 2 && rows[0].size() == 2 && rows[0][1] == L"y\"zzzzzzzzzz");
+  CHECK(rows.size() == 2 && rows[1].size() == 1 && rows[1][0] == L"last");
+}
+
+static std::wstring random_field() {
+  static const wchar_t chars[] = L"ab ,\"\r\n\x0416";
+  std::wstring field;
+  size_t len = rand() % 6;
+  for (size_t i = 0; i < len; i++) {
+    field += chars[rand() % (sizeof(chars) / sizeof(chars[0]) - 1)];
+  }
+  return field;
+}
+
+static std::wstring serialize(const CSV& rows) {
+  std::wstring text;
+  for (size_t r = 0; r < rows.size(); r++) {
+    for (size_t f = 0; f < rows[r].size(); f++) {
+      const std::wstring& field = rows[r][f];
+      if (f > 0) {
+        text += L',';
+      }
+      // Empty fields are quoted, a trailing unquoted one would be lost
+      if (field.empty() || field.find_first_of(L",\"\r\n") != std::wstring::npos) {
+        text += L'"';
+        for (size_t i = 0; i < field.size(); i++) {
+          text += field[i];
+          if (field[i] == L'"') {
+            text += L'"';
+          }
+        }
+        text += L'"';
+      } else {
+        text += field;
+      }
+    }
+    text += (r % 2) ? L"\r\n" : L"\n";
+  }
+  return text;
+}
+
+static void test_random() {
+  srand(1);
+  for (int round = 0; round < 500; round++) {
+    CSV rows(1 + rand() % 8);
+    for (size_t r = 0; r < rows.size(); r++) {
+      rows[r].resize(1 + rand() % 4);
+      for (size_t f = 0; f < rows[r].size(); f++) {
+        rows[r][f] = random_field();
+      }
+    }
+    std::wstring text = serialize(rows);
+
+    std::vector<size_t> pieces;
+    for (size_t left = text.size(); left > 0; ) {
+      size_t n = 1 + rand() % 7;
+      pieces.push_back(n);
+      left -= n < left ? n : left;
+    }
+    PieceSource whole(text, std::vector<size_t>());
+    CsvParser wparser(whole);
+    PieceSource split(text, pieces);
+    CsvParser sparser(split);
+    std::wistringstream stream(text);
+    CsvParser fparser(stream);
+
+    CHECK(parse_views(wparser) == rows);
+    CHECK(parse_views(sparser) == rows);
+    CHECK(parse_fields(fparser) == rows);
+  }
+}
+
+int main() {
+  test_in_place();
+  test_refill();
+  test_random();
+  return CHECK_RESULT();
+}
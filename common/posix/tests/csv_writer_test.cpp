@@ -0,0 +1,48 @@
+// CSVWriter writes numbers of every type without the locale, and doubles
+// in the shortest form that reads back the same
+
+#include "stdafx.h"
+#include <limits.h>
+#include <locale>
+
+#include "CSVWriter.h"
+#include "check.h"
+
+// Groups thousands with ',' and uses ',' as the radix character,
+// what the stream would put into numbers in some locales
+class GroupingPunct : public std::numpunct<wchar_t> {
+protected:
+  wchar_t do_decimal_point() const { return L','; }
+  wchar_t do_thousands_sep() const { return L'\''; }
+  std::string do_grouping() const { return "\3"; }
+};
+
+static void test_integers() {
+  CSVWriter csv;
+  csv << static_cast<short>(-1234) << static_cast<unsigned short>(65535)
+      << 1234567 << 4000000000u << -1234567L << 1234567UL
+      << LLONG_MIN << ULLONG_MAX << static_cast<size_t>(1000);
+  CHECK(csv.toString() == L"-1234;65535;1234567;4000000000;-1234567;1234567;"
+                          L"-9223372036854775808;18446744073709551615;1000");
+}
+
+static void test_doubles() {
+  CSVWriter csv;
+  csv << 0.1 << 1234567.5 << -2.5e-7 << 1e16 << 0.0;
+  CHECK(csv.toString() == L"0.1;1234567.5;-2.5e-07;1e+16;0");
+}
+
+static void test_mixed() {
+  CSVWriter csv(L",");
+  csv.newRow() << L"a" << 1 << 2.5;
+  csv.newRow() << L"b,c" << 3u << L"d\"e";
+  CHECK(csv.toString() == L"a,1,2.5\n\"b,c\",3,\"d\"\"e\"");
+}
+
+int main() {
+  std::locale::global(std::locale(std::locale::classic(), new GroupingPunct));
+  test_integers();
+  test_doubles();
+  test_mixed();
+  return CHECK_RESULT();
+}
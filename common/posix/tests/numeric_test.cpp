@@ -0,0 +1,166 @@
+// Numeric::ParseDouble reads the same double and stops at the same place as
+// wcstod_l in the C locale: on the Clinger and Eisel-Lemire paths, on
+// mantissas of more than 19 digits that are truncated, on halfway points
+// between doubles, near the ends of the range and on random numbers. Where
+// the CRT reports an error or finds no number, ParseDouble fails
+
+#include "stdafx.h"
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <string>
+
+#include "numeric.h"
+#include "check.h"
+
+static locale_t clocale;
+static size_t differ = 0;
+
+static void compare(const std::wstring& text) {
+  const wchar_t *str = text.c_str();
+  wchar_t *crtend;
+  errno = 0;
+  double crt = wcstod_l(str, &crtend, clocale);
+  bool crtok = (errno != ERANGE) && (crtend != str);
+
+  const wchar_t *end = NULL;
+  double val = 0;
+  bool ok = Numeric::ParseDouble(str, end, val);
+  bool same = ok == crtok;
+  if (same && ok) {
+    same = (memcmp(&val, &crt, sizeof(val)) == 0) && (end == crtend);
+  }
+  // the counted overload takes only a number with white space around it
+  double counted = 0;
+  bool whole = crtok && (wcsspn(crtend, L" \t\r\n") == wcslen(crtend));
+  if (same && (Numeric::ParseDouble(str, text.size(), counted) != whole ||
+               (whole && memcmp(&counted, &crt, sizeof(crt)) != 0))) {
+    same = false;
+  }
+  if (!same && differ++ < 10) {
+    fprintf(stderr, "\"%ls\": %s %.17g at %td, wcstod_l %s %.17g at %td\n", str,
+            ok ? "read" : "failed", val, ok ? end - str : -1,
+            crtok ? "read" : "failed", crt, crtend - str);
+  }
+}
+
+static void test_edges() {
+  static const wchar_t *edges[] = {
+    // Clinger
+    L"0", L"-0", L"+0.0e10", L"1", L"-1.5", L"123456789e-22", L"1e22", L"1e23", L"9007199254740992",
+    L"9007199254740993", L"9007199254740995", L"0.1", L".5", L"5.", L"  \t42", L"3.25e+2x",
+    // more than 19 digits
+    L"12345678901234567890", L"12345678901234567890123456789", L"1234567890123456789.5",
+    L"9007199254740992.5000000000000000001", L"9007199254740993.00000000000000000000000001",
+    L"9007199254740994.99999999999999999999999", L"0.30000000000000000000000000000000001",
+    L"4.9406564584124654417656879286822137236505980e-324",
+    L"2.4703282292062327208828439643411068618252990130716238221279284125033775364e-324",
+    L"2.2250738585072011e-308", L"2.2250738585072012e-308", L"2.2250738585072014e-308",
+    L"1.7976931348623157e308", L"1.7976931348623158e308", L"1.7976931348623159e308", L"1.8e308",
+    L"179769313486231580793728971405301e276",
+    // ends of the power table
+    L"1e308", L"1e309", L"1e-342", L"1e-343", L"9.9e-342", L"1e-324", L"1e-400", L"123e-345",
+    L"1e-307", L"1e-308", L"1e-309", L"1e-320",
+    // leading zeros of a fraction
+    L"0.000000000000000000000000000000000000001", L"0.0000000000000000000001234567890123456789012",
+    L"000000000000000000000000000001.5", L"0.00000000000000000000000000000000000000e999",
+    L"-0.0000000000000000000000000000000000000000000000000000000000000000001e-280",
+    // not quite numbers
+    L"", L"-", L"+", L".", L"-.", L"e5", L"1e", L"1e+", L"1.e-", L".e1", L"1..2", L"1e5e5", L"--1",
+    L"0x1p3", L"0X10", L"inf", L"-Infinity", L"nan", L"1,5", L"1e99999999999999", L"1e-99999999999"
+  };
+  for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+    compare(edges[i]);
+  }
+}
+
+static unsigned long long random_bits() {
+  unsigned long long bits = 0;
+  for (int i = 0; i < 5; i++) {
+    bits = (bits << 15) ^ static_cast<unsigned long long>(rand());
+  }
+  return bits;
+}
+
+// Doubles printed with too few, just enough and too many digits
+static void test_random_doubles() {
+  wchar_t buf[64];
+  for (int i = 0; i < 100000; i++) {
+    unsigned long long bits = random_bits();
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    if (!isfinite(d)) {
+      continue;
+    }
+    swprintf(buf, 64, L"%.*e", rand() % 25, d);
+    compare(buf);
+    swprintf(buf, 64, L"%.17g", d);
+    compare(buf);
+  }
+}
+
+// Digit strings of every length, with a point somewhere and any exponent
+static void test_random_digits() {
+  for (int i = 0; i < 100000; i++) {
+    std::wstring text;
+    int len = 1 + rand() % 40;
+    int point = rand() % (len + 1);
+    int zeros = rand() % 4 == 0 ? rand() % 30 : 0;
+    for (int d = 0; d < len; d++) {
+      if (d == point) {
+        text += L'.';
+        text.append(zeros, L'0');
+      }
+      text += static_cast<wchar_t>(L'0' + (d == 0 ? 1 + rand() % 9 : rand() % 10));
+    }
+    if (rand() % 2) {
+      text += L'e';
+      text += std::to_wstring(rand() % 700 - 360);
+    }
+    compare(text);
+  }
+}
+
+// Exactly halfway between two doubles, a hair above and below it, and the
+// halfway digits cut after the 19th so only the truncated path can tell
+static void test_halfway() {
+  if (sizeof(long double) <= sizeof(double)) {
+    return; // can't hold the point between two doubles
+  }
+  static wchar_t buf[1024];
+  for (int i = 0; i < 20000; i++) {
+    unsigned long long bits = random_bits() & 0x7FEFFFFFFFFFFFFFULL;
+    double lo;
+    memcpy(&lo, &bits, sizeof(lo));
+    double hi = nextafter(lo, INFINITY);
+    long double half = (static_cast<long double>(lo) + hi) / 2;
+    swprintf(buf, 1024, L"%.800Le", half);
+    std::wstring exact(buf);
+    size_t e = exact.find(L'e');
+    std::wstring digits = exact.substr(0, e);
+    std::wstring exponent = exact.substr(e);
+    digits.erase(digits.find_last_not_of(L'0') + 1);
+    compare(digits + exponent);
+    compare(digits + L"000000000000000000001" + exponent);
+    compare(digits.substr(0, 21) + exponent);
+    if (digits.size() > 22) {
+      // just below: the last digit lowered, the rest nines
+      std::wstring below = digits.substr(0, 22);
+      below[21] = below[21] == L'0' ? L'0' : static_cast<wchar_t>(below[21] - 1);
+      compare(below + L"9999999999999999" + exponent);
+    }
+  }
+}
+
+int main() {
+  clocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+  srand(19);
+  test_edges();
+  test_random_doubles();
+  test_random_digits();
+  test_halfway();
+  CHECK(differ == 0);
+  return CHECK_RESULT();
+}
@@ -0,0 +1,79 @@
+// Utils::CanonicalPath on the table of pathcases.h, and against the AbsPath
+// it replaced on every path put together from a few tricky fragments
+
+#include "stdafx.h"
+#include <string>
+
+#include "abspath.h"
+#include "pathcases.h"
+#include "check.h"
+
+static bool same(LPCWSTR a, LPCWSTR b) {
+  if (a == NULL || b == NULL) {
+    return a == b;
+  }
+  return wcscmp(a, b) == 0;
+}
+
+static void test_table() {
+  for (size_t i = 0; i < _countof(PathCases::cases); i++) {
+    const PathCases::CASE& c = PathCases::cases[i];
+    WCHAR buf[256];
+    Utils::PATHINFO info = { 0, 0 };
+    SIZE_T len = Utils::CanonicalPath(c.path, c.reference, buf, _countof(buf), &info, c.reflock);
+    bool ok = same(len > 0 ? buf : NULL, c.expected);
+    if (len > 0) {
+      ok = ok && len == wcslen(buf) && info.root == c.root && info.tokens == c.tokens;
+    }
+    // the table is what AbsPath made of the same paths
+    LPWSTR legacy = Legacy::AbsPath(c.path, c.reference, c.reflock);
+    ok = ok && same(legacy, c.expected);
+    delete[] legacy;
+    if (!ok) {
+      fprintf(stderr, "case %zu: \"%ls\" against \"%ls\"\n", i, c.path, c.reference);
+    }
+    CHECK(ok);
+  }
+}
+
+static void test_fragments() {
+  // every path of three fragments, against every reference and both locks
+  const size_t count = _countof(PathCases::fragments);
+  size_t differ = 0;
+  for (size_t i = 0; i < count * count * count; i++) {
+    std::wstring path(PathCases::fragments[i % count]);
+    path += PathCases::fragments[i / count % count];
+    path += PathCases::fragments[i / count / count];
+    for (size_t r = 0; r < _countof(PathCases::references) * 2; r++) {
+      LPCWSTR reference = PathCases::references[r / 2];
+      BOOL reflock = r % 2;
+      WCHAR buf[256];
+      SIZE_T len = Utils::CanonicalPath(path.c_str(), reference, buf, _countof(buf), NULL, reflock);
+      LPWSTR legacy = Legacy::AbsPath(path.c_str(), reference, reflock);
+      if (!same(len > 0 ? buf : NULL, legacy) && differ++ < 10) {
+        fprintf(stderr, "\"%ls\" against \"%ls\"%s: \"%ls\", was \"%ls\"\n", path.c_str(), reference,
+                reflock ? " locked" : "", len > 0 ? buf : L"(refused)", legacy != NULL ? legacy : L"(refused)");
+      }
+      delete[] legacy;
+    }
+  }
+  CHECK(differ == 0);
+}
+
+static void test_buffer() {
+  // the size the header promises is enough, a character less is not
+  LPCWSTR reference = L"C:\\Work";
+  LPCWSTR path = L"out";
+  WCHAR buf[16];
+  SIZE_T need = wcslen(reference) + wcslen(path) + 2;
+  CHECK(Utils::CanonicalPath(path, reference, buf, need) == 11);
+  CHECK(wcscmp(buf, L"C:\\Work\\out") == 0);
+  CHECK(Utils::CanonicalPath(path, reference, buf, need - 1) == 0);
+}
+
+int main() {
+  test_table();
+  test_fragments();
+  test_buffer();
+  return CHECK_RESULT();
+}
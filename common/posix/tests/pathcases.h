@@ -0,0 +1,82 @@
+#ifndef _PATHCASES_H
+#define _PATHCASES_H
+
+// Paths and what Utils::CanonicalPath makes of them, shared by path_test
+// and bench_path. The results are those of the sanitizing rules of
+// SanitizeFileSystemString, which AbsPath (see abspath.h) applied before
+
+#include "utils.h"
+
+namespace PathCases {
+
+	typedef struct {
+		LPCWSTR path;
+		LPCWSTR reference;
+		BOOL reflock;
+		LPCWSTR expected;	// NULL for a path that is refused
+		SIZE_T root;		// PATHINFO of the result
+		SIZE_T tokens;
+		BOOL typical;		// what ComposeDir gets from usual templates
+	} CASE;
+
+	static const CASE cases[] = {
+		// relative to the document folder, the usual
+		{ L"out", L"C:\\Work\\Project", FALSE, L"C:\\Work\\Project\\out", 3, 3, TRUE },
+		{ L"out\\", L"C:\\Work\\Project", FALSE, L"C:\\Work\\Project\\out", 3, 3, TRUE },
+		{ L"..\\out", L"C:\\Work\\Project", FALSE, L"C:\\Work\\out", 3, 2, TRUE },
+		{ L"..\\..\\..\\out", L"C:\\Work\\Project", FALSE, L"C:\\out", 3, 1, FALSE },
+		{ L".\\a\\.\\b\\..\\c", L"C:\\Work\\Project", FALSE, L"C:\\Work\\Project\\a\\c", 3, 4, TRUE },
+		{ L"\\root\\dir", L"C:\\Work\\Project", FALSE, L"C:\\root\\dir", 3, 2, FALSE },
+		{ L"", L"C:\\Work\\Project", FALSE, L"C:\\Work\\Project", 3, 2, TRUE },
+		{ L"", L"C:\\Work\\Project\\", FALSE, L"C:\\Work\\Project", 3, 2, FALSE },
+		{ L"x\\..", L"C:\\", FALSE, L"C:\\", 3, 0, FALSE },
+		{ L"..", L"C:\\", FALSE, L"C:\\", 3, 0, FALSE },
+		{ L"a\\b\\", L"C:\\Work", FALSE, L"C:\\Work\\a\\b", 3, 3, FALSE },
+		{ L"Export\\\x0414\x0435\x0442\x0430\x043B\x044C 12\\STEP", L"C:\\\x041F\x0440\x043E\x0435\x043A\x0442",
+			FALSE, L"C:\\\x041F\x0440\x043E\x0435\x043A\x0442\\Export\\\x0414\x0435\x0442\x0430\x043B\x044C 12\\STEP", 3, 4, TRUE },
+		// sanitizing
+		{ L"a\\\\b\\\\\\c", L"C:\\Work", FALSE, L"C:\\Work\\a\\b\\c", 3, 4, FALSE },
+		{ L" a . \\ b.. \\c ", L"C:\\Work", FALSE, L"C:\\Work\\a\\b\\c", 3, 4, TRUE },
+		{ L"a\\...\\b", L"C:\\Work", FALSE, L"C:\\Work\\a\\b", 3, 3, FALSE },
+		{ L"a<b>c|d?e*f\"g:h", L"C:\\Work", FALSE, L"C:\\Work\\a_b_c_d_e_f_g_h", 3, 2, TRUE },
+		{ L"a\tb\x01" L"c", L"C:\\Work", FALSE, L"C:\\Work\\a_b_c", 3, 2, FALSE },
+		// locked reference, '..' and '\' stop at it
+		{ L"..\\up", L"C:\\Work\\Project", TRUE, L"C:\\Work\\Project\\up", 16, 1, FALSE },
+		{ L"\\root", L"C:\\Work\\Project", TRUE, L"C:\\Work\\Project\\root", 16, 1, FALSE },
+		// absolute
+		{ L"D:\\Other\\.\\x\\..\\y", L"C:\\Work", FALSE, L"D:\\Other\\y", 3, 2, TRUE },
+		{ L"\\\\?\\C:\\long\\path\\..\\x", L"C:\\Work", FALSE, L"\\\\?\\C:\\long\\x", 7, 2, FALSE },
+		{ L"\\\\.\\C:\\dev", L"C:\\Work", FALSE, L"\\\\.\\C:\\dev", 7, 1, FALSE },
+		// network, the share is part of the root
+		{ L"out", L"\\\\server\\share\\dir", FALSE, L"\\\\server\\share\\dir\\out", 15, 2, TRUE },
+		{ L"..\\..\\out", L"\\\\server\\share\\dir", FALSE, L"\\\\server\\share\\out", 15, 1, FALSE },
+		{ L"\\\\server\\share\\a\\..\\..\\b", L"C:\\Work", FALSE, L"\\\\server\\share\\b", 15, 1, FALSE },
+		{ L"\\\\?\\UNC\\server\\share\\x", L"C:\\Work", FALSE, L"\\\\?\\UNC\\server\\share\\x", 21, 1, FALSE },
+		{ L"\\\\server", L"C:\\Work", FALSE, L"\\\\server", 2, 1, FALSE },
+		// prefixes that only look like ones are plain names
+		{ L"pipe\\x", L"C:\\Work", FALSE, L"C:\\Work\\pipe\\x", 3, 3, FALSE },
+		{ L"UNC\\x", L"C:\\Work", FALSE, L"C:\\Work\\UNC\\x", 3, 3, FALSE },
+		{ L"Volume{00000000-0000-0000-0000-000000000000}\\x", L"C:\\Work", FALSE,
+			L"C:\\Work\\Volume{00000000-0000-0000-0000-000000000000}\\x", 3, 3, FALSE },
+		// refused
+		{ L"D:relative", L"C:\\Work", FALSE, NULL, 0, 0, FALSE },
+		{ L"\\\\.server\\share", L"C:\\Work", FALSE, NULL, 0, 0, FALSE },
+		{ L"\\\\ser:ver\\share", L"C:\\Work", FALSE, NULL, 0, 0, FALSE },
+		{ L"\\\\.\\pipe\\name", L"C:\\Work", FALSE, NULL, 0, 0, FALSE },
+		{ L"\\\\.\\COM1", L"C:\\Work", FALSE, NULL, 0, 0, FALSE },
+		{ L"out", L"relative\\ref", FALSE, NULL, 0, 0, FALSE }
+	};
+
+	// pieces path_test puts together to compare CanonicalPath with AbsPath
+	static const LPCWSTR fragments[] = {
+		L"", L"a", L"\\", L"\\\\", L".", L"..", L"...", L" ", L"b ", L" c.", L"d:e", L"\t",
+		L"\\\\srv\\shr", L"\\\\?\\D:", L"\\\\.\\E:", L"F:\\", L"pipe\\", L"UNC\\"
+	};
+
+	static const LPCWSTR references[] = {
+		L"C:\\Work\\Project", L"C:\\", L"\\\\server\\share\\dir", L"\\\\?\\C:\\long", L"\\\\.\\C:\\dev\\x"
+	};
+
+} /* PathCases */
+
+#endif /* _PATHCASES_H */
@@ -0,0 +1,99 @@
+#ifndef _UNSLASH_H
+#define _UNSLASH_H
+
+// Utils::UnSlash as it was before it decoded from a table, kept for the
+// tests to compare with and for the benchmark to measure against
+
+#include "utils.h"
+
+namespace Legacy {
+
+	inline INT GetHexDigit( WCHAR ch )
+	{
+		if (ch >= '0' && ch <= '9')
+			return ch - '0';
+		if (ch >= 'A' && ch <= 'F')
+			return ch - 'A' + 10;
+		if (ch >= 'a' && ch <= 'f')
+			return ch - 'a' + 10;
+		return -1;
+	}
+
+	// \a, \b, \f, \n, \r, \t, \v, \xhh and \uhhhh; a lone trailing
+	// backslash counts one more in the returned length
+	inline UINT UnSlash( LPWSTR s )
+	{
+		LPWSTR sStart = s;
+		LPWSTR o = s;
+
+		while (*s) {
+			if (*s == '\\') {
+				s++;
+				if (*s == 'a')
+					*o = '\a';
+				else if (*s == 'b')
+					*o = '\b';
+				else if (*s == 'f')
+					*o = '\f';
+				else if (*s == 'n')
+					*o = '\n';
+				else if (*s == 'r')
+					*o = '\r';
+				else if (*s == 't')
+					*o = '\t';
+				else if (*s == 'v')
+					*o = '\v';
+				else if (*s == 'x' || *s == 'u') {
+					BOOL bShort = (*s == 'x');
+					WCHAR val;
+					INT hex;
+					val = 0;
+					hex = GetHexDigit(*(s+1));
+					if (hex >= 0) {
+						s++;
+						val = hex;
+						hex = GetHexDigit(*(s+1));
+						if (hex >= 0) {
+							s++;
+							val *= 16;
+							val += hex;
+							if (!bShort) {
+								hex = GetHexDigit(*(s+1));
+								if (hex >= 0) {
+									s++;
+									val *= 16;
+									val += hex;
+									hex = GetHexDigit(*(s+1));
+									if (hex >= 0) {
+										s++;
+										val *= 16;
+										val += hex;
+									}
+								}
+							}
+						}
+						if (val)
+							*o = val;
+						else
+							o--;
+					}
+					else
+						o--;
+				}
+				else
+					*o = *s;
+			}
+			else
+				*o = *s;
+			o++;
+			if (*s) {
+				s++;
+			}
+		}
+		*o = '\0';
+		return (UINT)(o - sStart);
+	}
+
+} /* Legacy */
+
+#endif /* _UNSLASH_H */
@@ -0,0 +1,73 @@
+// Utils::UnSlash on each escape, and against the decoder it replaced on
+// text with plain runs of every length around the bulk-move threshold
+
+#include "stdafx.h"
+#include <string>
+#include <vector>
+
+#include "unslash.h"
+#include "check.h"
+
+static std::wstring unslash(const std::wstring& text, UINT *len = NULL) {
+  std::vector<WCHAR> buf(text.begin(), text.end());
+  buf.push_back(L'\0');
+  UINT n = Utils::UnSlash(&buf[0]);
+  if (len != NULL) {
+    *len = n;
+  }
+  return std::wstring(&buf[0]);
+}
+
+static void test_escapes() {
+  CHECK(unslash(L"\\a\\b\\f\\n\\r\\t\\v") == L"\a\b\f\n\r\t\v");
+  CHECK(unslash(L"a\\\\b\\\"c\\q") == L"a\\b\"cq");
+  CHECK(unslash(L"\\x41\\x4G\\x\\u0414\\u41z") == L"A\x04G\x0414\x41z");
+  CHECK(unslash(L"<\\x00\\u0000\\U00110000>") == L"<>");
+#if WCHAR_MAX <= 0xFFFF
+  CHECK(unslash(L"\\U0001F600") == L"\xD83D\xDE00");
+#else
+  CHECK(unslash(L"\\U0001F600") == L"\x1F600");
+#endif
+  CHECK(unslash(L"\\U41!") == L"A!");
+
+  UINT len = 0;
+  CHECK(unslash(L"tail\\", &len) == L"tail");
+  CHECK(len == 4);
+  CHECK(unslash(L"", &len) == L"");
+  CHECK(len == 0);
+}
+
+static void test_legacy() {
+  // plain runs of 0 to 40 characters between escapes, the old decoder
+  // must agree on everything but \U
+  static const wchar_t *escapes[] = { L"\\n", L"\\t", L"\\\\", L"\\x41", L"\\u0431", L"\\x", L"\\z" };
+  size_t differ = 0;
+  for (size_t run = 0; run <= 40; run++) {
+    for (size_t e = 0; e < _countof(escapes); e++) {
+      std::wstring text;
+      for (size_t i = 0; i < 5; i++) {
+        for (size_t c = 0; c < run; c++) {
+          text += static_cast<wchar_t>(L'a' + (i + c) % 26);
+        }
+        text += escapes[(e + i) % _countof(escapes)];
+      }
+      text += std::wstring(run, L'z');
+
+      std::vector<WCHAR> old(text.begin(), text.end());
+      old.push_back(L'\0');
+      UINT oldlen = Legacy::UnSlash(&old[0]);
+      UINT len = 0;
+      std::wstring now = unslash(text, &len);
+      if ((now != &old[0] || len != oldlen) && differ++ < 10) {
+        fprintf(stderr, "run %zu escape %zu: \"%ls\", was \"%ls\"\n", run, e, now.c_str(), &old[0]);
+      }
+    }
+  }
+  CHECK(differ == 0);
+}
+
+int main() {
+  test_escapes();
+  test_legacy();
+  return CHECK_RESULT();
+}
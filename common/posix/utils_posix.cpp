@@ -0,0 +1,33 @@
+#include "stdafx.h"
+
+// POSIX counterparts of the Win32 part of Utils the platform independent
+// code may need; see utils.cpp for the Windows ones
+
+#include <dlfcn.h>
+#include <limits.h>
+
+#include "../utils.h"
+
+DWORD Utils::GetModulePathName( LPWSTR pathname, SIZE_T pnsz, SIZE_T *nameidx /* = NULL */ )
+{
+	Dl_info info;
+	if (!dladdr((void *) &GetModulePathName, &info) || (info.dli_fname == NULL))
+		return 0;
+
+	char real[PATH_MAX];
+	if (realpath(info.dli_fname, real) == NULL)
+		return 0;
+
+	SIZE_T len = mbstowcs(pathname, real, pnsz);
+	if ((len == (SIZE_T)-1) || (len == pnsz))
+		return 0;
+
+	if (nameidx) {
+		LPWSTR mname = pathname;
+		for(LPWSTR mptr = pathname; *mptr != '\0' && mptr < pathname + pnsz; mptr++)
+			if (*mptr == '/') mname = mptr + 1;
+		*nameidx = mname - pathname;
+	}
+
+	return (DWORD)len;
+}
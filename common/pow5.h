@@ -0,0 +1,1338 @@
+#ifndef _POW5_H
+#define _POW5_H
+
+// 5^-q and 5^i as 125 bit fixed point numbers, low half first.
+// Generated: 2^(bitlength(5^q) - 1 + 125) / 5^q + 1 and the
+// top 125 bits of 5^i
+static const unsigned long long s_pow5invsplit[342][2] = {
+	{                    1ULL,  2305843009213693952ULL },
+	{ 11068046444225730970ULL,  1844674407370955161ULL },
+	{  5165088340638674453ULL,  1475739525896764129ULL },
+	{  7821419487252849886ULL,  1180591620717411303ULL },
+	{  8824922364862649494ULL,  1888946593147858085ULL },
+	{  7059937891890119595ULL,  1511157274518286468ULL },
+	{ 13026647942995916322ULL,  1208925819614629174ULL },
+	{  9774590264567735146ULL,  1934281311383406679ULL },
+	{ 11509021026396098440ULL,  1547425049106725343ULL },
+	{ 16585914450600699399ULL,  1237940039285380274ULL },
+	{ 15469416676735388068ULL,  1980704062856608439ULL },
+	{ 16064882156130220778ULL,  1584563250285286751ULL },
+	{  9162556910162266299ULL,  1267650600228229401ULL },
+	{  7281393426775805432ULL,  2028240960365167042ULL },
+	{ 16893161185646375315ULL,  1622592768292133633ULL },
+	{  2446482504291369283ULL,  1298074214633706907ULL },
+	{  7603720821608101175ULL,  2076918743413931051ULL },
+	{  2393627842544570617ULL,  1661534994731144841ULL },
+	{ 16672297533003297786ULL,  1329227995784915872ULL },
+	{ 11918280793837635165ULL,  2126764793255865396ULL },
+	{  5845275820328197809ULL,  1701411834604692317ULL },
+	{ 15744267100488289217ULL,  1361129467683753853ULL },
+	{  3054734472329800808ULL,  2177807148294006166ULL },
+	{ 17201182836831481939ULL,  1742245718635204932ULL },
+	{  6382248639981364905ULL,  1393796574908163946ULL },
+	{  2832900194486363201ULL,  2230074519853062314ULL },
+	{  5955668970331000884ULL,  1784059615882449851ULL },
+	{  1075186361522890384ULL,  1427247692705959881ULL },
+	{ 12788344622662355584ULL,  2283596308329535809ULL },
+	{ 13920024512871794791ULL,  1826877046663628647ULL },
+	{  3757321980813615186ULL,  1461501637330902918ULL },
+	{ 10384555214134712795ULL,  1169201309864722334ULL },
+	{  5547241898389809503ULL,  1870722095783555735ULL },
+	{  4437793518711847602ULL,  1496577676626844588ULL },
+	{ 10928932444453298728ULL,  1197262141301475670ULL },
+	{ 17486291911125277965ULL,  1915619426082361072ULL },
+	{  6610335899416401726ULL,  1532495540865888858ULL },
+	{ 12666966349016942027ULL,  1225996432692711086ULL },
+	{ 12888448528943286597ULL,  1961594292308337738ULL },
+	{ 17689456452638449924ULL,  1569275433846670190ULL },
+	{ 14151565162110759939ULL,  1255420347077336152ULL },
+	{  7885109000409574610ULL,  2008672555323737844ULL },
+	{  9997436015069570011ULL,  1606938044258990275ULL },
+	{  7997948812055656009ULL,  1285550435407192220ULL },
+	{ 12796718099289049614ULL,  2056880696651507552ULL },
+	{  2858676849947419045ULL,  1645504557321206042ULL },
+	{ 13354987924183666206ULL,  1316403645856964833ULL },
+	{ 17678631863951955605ULL,  2106245833371143733ULL },
+	{  3074859046935833515ULL,  1684996666696914987ULL },
+	{ 13527933681774397782ULL,  1347997333357531989ULL },
+	{ 10576647446613305481ULL,  2156795733372051183ULL },
+	{ 15840015586774465031ULL,  1725436586697640946ULL },
+	{  8982663654677661702ULL,  1380349269358112757ULL },
+	{ 18061610662226169046ULL,  2208558830972980411ULL },
+	{ 10759939715039024913ULL,  1766847064778384329ULL },
+	{ 12297300586773130254ULL,  1413477651822707463ULL },
+	{ 15986332124095098083ULL,  2261564242916331941ULL },
+	{  9099716884534168143ULL,  1809251394333065553ULL },
+	{ 14658471137111155161ULL,  1447401115466452442ULL },
+	{  4348079280205103483ULL,  1157920892373161954ULL },
+	{ 14335624477811986218ULL,  1852673427797059126ULL },
+	{  7779150767507678651ULL,  1482138742237647301ULL },
+	{  2533971799264232598ULL,  1185710993790117841ULL },
+	{ 15122401323048503126ULL,  1897137590064188545ULL },
+	{ 12097921058438802501ULL,  1517710072051350836ULL },
+	{  5988988032009131678ULL,  1214168057641080669ULL },
+	{ 16961078480698431330ULL,  1942668892225729070ULL },
+	{ 13568862784558745064ULL,  1554135113780583256ULL },
+	{  7165741412905085728ULL,  1243308091024466605ULL },
+	{ 11465186260648137165ULL,  1989292945639146568ULL },
+	{ 16550846638002330379ULL,  1591434356511317254ULL },
+	{ 16930026125143774626ULL,  1273147485209053803ULL },
+	{  4951948911778577463ULL,  2037035976334486086ULL },
+	{   272210314680951647ULL,  1629628781067588869ULL },
+	{  3907117066486671641ULL,  1303703024854071095ULL },
+	{  6251387306378674625ULL,  2085924839766513752ULL },
+	{ 16069156289328670670ULL,  1668739871813211001ULL },
+	{  9165976216721026213ULL,  1334991897450568801ULL },
+	{  7286864317269821294ULL,  2135987035920910082ULL },
+	{ 16897537898041588005ULL,  1708789628736728065ULL },
+	{ 13518030318433270404ULL,  1367031702989382452ULL },
+	{  6871453250525591353ULL,  2187250724783011924ULL },
+	{  9186511415162383406ULL,  1749800579826409539ULL },
+	{ 11038557946871817048ULL,  1399840463861127631ULL },
+	{ 10282995085511086630ULL,  2239744742177804210ULL },
+	{  8226396068408869304ULL,  1791795793742243368ULL },
+	{ 13959814484210916090ULL,  1433436634993794694ULL },
+	{ 11267656730511734774ULL,  2293498615990071511ULL },
+	{  5324776569667477496ULL,  1834798892792057209ULL },
+	{  7949170070475892320ULL,  1467839114233645767ULL },
+	{ 17427382500606444826ULL,  1174271291386916613ULL },
+	{  5747719112518849781ULL,  1878834066219066582ULL },
+	{ 15666221734240810795ULL,  1503067252975253265ULL },
+	{ 12532977387392648636ULL,  1202453802380202612ULL },
+	{  5295368560860596524ULL,  1923926083808324180ULL },
+	{  4236294848688477220ULL,  1539140867046659344ULL },
+	{  7078384693692692099ULL,  1231312693637327475ULL },
+	{ 11325415509908307358ULL,  1970100309819723960ULL },
+	{  9060332407926645887ULL,  1576080247855779168ULL },
+	{ 14626963555825137356ULL,  1260864198284623334ULL },
+	{ 12335095245094488799ULL,  2017382717255397335ULL },
+	{  9868076196075591040ULL,  1613906173804317868ULL },
+	{ 15273158586344293478ULL,  1291124939043454294ULL },
+	{ 13369007293925138595ULL,  2065799902469526871ULL },
+	{  7005857020398200553ULL,  1652639921975621497ULL },
+	{ 16672732060544291412ULL,  1322111937580497197ULL },
+	{ 11918976037903224966ULL,  2115379100128795516ULL },
+	{  5845832015580669650ULL,  1692303280103036413ULL },
+	{ 12055363241948356366ULL,  1353842624082429130ULL },
+	{   841837113407818570ULL,  2166148198531886609ULL },
+	{  4362818505468165179ULL,  1732918558825509287ULL },
+	{ 14558301248600263113ULL,  1386334847060407429ULL },
+	{ 12225235553534690011ULL,  2218135755296651887ULL },
+	{  2401490813343931363ULL,  1774508604237321510ULL },
+	{  1921192650675145090ULL,  1419606883389857208ULL },
+	{ 17831303500047873437ULL,  2271371013423771532ULL },
+	{  6886345170554478103ULL,  1817096810739017226ULL },
+	{  1819727321701672159ULL,  1453677448591213781ULL },
+	{ 16213177116328979020ULL,  1162941958872971024ULL },
+	{ 14873036941900635463ULL,  1860707134196753639ULL },
+	{ 15587778368262418694ULL,  1488565707357402911ULL },
+	{  8780873879868024632ULL,  1190852565885922329ULL },
+	{  2981351763563108441ULL,  1905364105417475727ULL },
+	{ 13453127855076217722ULL,  1524291284333980581ULL },
+	{  7073153469319063855ULL,  1219433027467184465ULL },
+	{ 11317045550910502167ULL,  1951092843947495144ULL },
+	{ 12742985255470312057ULL,  1560874275157996115ULL },
+	{ 10194388204376249646ULL,  1248699420126396892ULL },
+	{  1553625868034358140ULL,  1997919072202235028ULL },
+	{  8621598323911307159ULL,  1598335257761788022ULL },
+	{ 17965325103354776697ULL,  1278668206209430417ULL },
+	{ 13987124906400001422ULL,  2045869129935088668ULL },
+	{   121653480894270168ULL,  1636695303948070935ULL },
+	{    97322784715416134ULL,  1309356243158456748ULL },
+	{ 14913111714512307107ULL,  2094969989053530796ULL },
+	{  8241140556867935363ULL,  1675975991242824637ULL },
+	{ 17660958889720079260ULL,  1340780792994259709ULL },
+	{ 17189487779326395846ULL,  2145249268790815535ULL },
+	{ 13751590223461116677ULL,  1716199415032652428ULL },
+	{ 18379969808252713988ULL,  1372959532026121942ULL },
+	{ 14650556434236701088ULL,  2196735251241795108ULL },
+	{   652398703163629901ULL,  1757388200993436087ULL },
+	{ 11589965406756634890ULL,  1405910560794748869ULL },
+	{  7475898206584884855ULL,  2249456897271598191ULL },
+	{  2291369750525997561ULL,  1799565517817278553ULL },
+	{  9211793429904618695ULL,  1439652414253822842ULL },
+	{ 18428218302589300235ULL,  2303443862806116547ULL },
+	{  7363877012587619542ULL,  1842755090244893238ULL },
+	{ 13269799239553916280ULL,  1474204072195914590ULL },
+	{ 10615839391643133024ULL,  1179363257756731672ULL },
+	{  2227947767661371545ULL,  1886981212410770676ULL },
+	{ 16539753473096738529ULL,  1509584969928616540ULL },
+	{ 13231802778477390823ULL,  1207667975942893232ULL },
+	{  6413489186596184024ULL,  1932268761508629172ULL },
+	{ 16198837793502678189ULL,  1545815009206903337ULL },
+	{  5580372605318321905ULL,  1236652007365522670ULL },
+	{  8928596168509315048ULL,  1978643211784836272ULL },
+	{ 18210923379033183008ULL,  1582914569427869017ULL },
+	{  7190041073742725760ULL,  1266331655542295214ULL },
+	{   436019273762630246ULL,  2026130648867672343ULL },
+	{  7727513048493924843ULL,  1620904519094137874ULL },
+	{  9871359253537050198ULL,  1296723615275310299ULL },
+	{  4726128361433549347ULL,  2074757784440496479ULL },
+	{  7470251503888749801ULL,  1659806227552397183ULL },
+	{ 13354898832594820487ULL,  1327844982041917746ULL },
+	{ 13989140502667892133ULL,  2124551971267068394ULL },
+	{ 14880661216876224029ULL,  1699641577013654715ULL },
+	{ 11904528973500979224ULL,  1359713261610923772ULL },
+	{  4289851098633925465ULL,  2175541218577478036ULL },
+	{ 18189276137874781665ULL,  1740432974861982428ULL },
+	{  3483374466074094362ULL,  1392346379889585943ULL },
+	{  1884050330976640656ULL,  2227754207823337509ULL },
+	{  5196589079523222848ULL,  1782203366258670007ULL },
+	{ 15225317707844309248ULL,  1425762693006936005ULL },
+	{  5913764258841343181ULL,  2281220308811097609ULL },
+	{  8420360221814984868ULL,  1824976247048878087ULL },
+	{ 17804334621677718864ULL,  1459980997639102469ULL },
+	{ 17932816512084085415ULL,  1167984798111281975ULL },
+	{ 10245762345624985047ULL,  1868775676978051161ULL },
+	{  4507261061758077715ULL,  1495020541582440929ULL },
+	{  7295157664148372495ULL,  1196016433265952743ULL },
+	{  7982903447895485668ULL,  1913626293225524389ULL },
+	{ 10075671573058298858ULL,  1530901034580419511ULL },
+	{  4371188443704728763ULL,  1224720827664335609ULL },
+	{ 14372599139411386667ULL,  1959553324262936974ULL },
+	{ 15187428126271019657ULL,  1567642659410349579ULL },
+	{ 15839291315758726049ULL,  1254114127528279663ULL },
+	{  3206773216762499739ULL,  2006582604045247462ULL },
+	{ 13633465017635730761ULL,  1605266083236197969ULL },
+	{ 14596120828850494932ULL,  1284212866588958375ULL },
+	{  4907049252451240275ULL,  2054740586542333401ULL },
+	{   236290587219081897ULL,  1643792469233866721ULL },
+	{ 14946427728742906810ULL,  1315033975387093376ULL },
+	{ 16535586736504830250ULL,  2104054360619349402ULL },
+	{  5849771759720043554ULL,  1683243488495479522ULL },
+	{ 15747863852001765813ULL,  1346594790796383617ULL },
+	{ 10439186904235184007ULL,  2154551665274213788ULL },
+	{ 15730047152871967852ULL,  1723641332219371030ULL },
+	{ 12584037722297574282ULL,  1378913065775496824ULL },
+	{  9066413911450387881ULL,  2206260905240794919ULL },
+	{ 10942479943902220628ULL,  1765008724192635935ULL },
+	{  8753983955121776503ULL,  1412006979354108748ULL },
+	{ 10317025513452932081ULL,  2259211166966573997ULL },
+	{   874922781278525018ULL,  1807368933573259198ULL },
+	{  8078635854506640661ULL,  1445895146858607358ULL },
+	{ 13841606313089133175ULL,  1156716117486885886ULL },
+	{ 14767872471458792434ULL,  1850745787979017418ULL },
+	{   746251532941302978ULL,  1480596630383213935ULL },
+	{   597001226353042382ULL,  1184477304306571148ULL },
+	{ 15712597221132509104ULL,  1895163686890513836ULL },
+	{  8880728962164096960ULL,  1516130949512411069ULL },
+	{ 10793931984473187891ULL,  1212904759609928855ULL },
+	{ 17270291175157100626ULL,  1940647615375886168ULL },
+	{  2748186495899949531ULL,  1552518092300708935ULL },
+	{  2198549196719959625ULL,  1242014473840567148ULL },
+	{ 18275073973719576693ULL,  1987223158144907436ULL },
+	{ 10930710364233751031ULL,  1589778526515925949ULL },
+	{ 12433917106128911148ULL,  1271822821212740759ULL },
+	{  8826220925580526867ULL,  2034916513940385215ULL },
+	{  7060976740464421494ULL,  1627933211152308172ULL },
+	{ 16716827836597268165ULL,  1302346568921846537ULL },
+	{ 11989529279587987770ULL,  2083754510274954460ULL },
+	{  9591623423670390216ULL,  1667003608219963568ULL },
+	{ 15051996368420132820ULL,  1333602886575970854ULL },
+	{ 13015147745246481542ULL,  2133764618521553367ULL },
+	{  3033420566713364587ULL,  1707011694817242694ULL },
+	{  6116085268112601993ULL,  1365609355853794155ULL },
+	{  9785736428980163188ULL,  2184974969366070648ULL },
+	{ 15207286772667951197ULL,  1747979975492856518ULL },
+	{  1097782973908629988ULL,  1398383980394285215ULL },
+	{  1756452758253807981ULL,  2237414368630856344ULL },
+	{  5094511021344956708ULL,  1789931494904685075ULL },
+	{  4075608817075965366ULL,  1431945195923748060ULL },
+	{  6520974107321544586ULL,  2291112313477996896ULL },
+	{  1527430471115325346ULL,  1832889850782397517ULL },
+	{ 12289990821117991246ULL,  1466311880625918013ULL },
+	{ 17210690286378213644ULL,  1173049504500734410ULL },
+	{  9090360384495590213ULL,  1876879207201175057ULL },
+	{ 18340334751822203140ULL,  1501503365760940045ULL },
+	{ 14672267801457762512ULL,  1201202692608752036ULL },
+	{ 16096930852848599373ULL,  1921924308174003258ULL },
+	{  1809498238053148529ULL,  1537539446539202607ULL },
+	{ 12515645034668249793ULL,  1230031557231362085ULL },
+	{  1578287981759648052ULL,  1968050491570179337ULL },
+	{ 12330676829633449412ULL,  1574440393256143469ULL },
+	{ 13553890278448669853ULL,  1259552314604914775ULL },
+	{  3239480371808320148ULL,  2015283703367863641ULL },
+	{ 17348979556414297411ULL,  1612226962694290912ULL },
+	{  6500486015647617283ULL,  1289781570155432730ULL },
+	{ 10400777625036187652ULL,  2063650512248692368ULL },
+	{ 15699319729512770768ULL,  1650920409798953894ULL },
+	{ 16248804598352126938ULL,  1320736327839163115ULL },
+	{  7551343283653851484ULL,  2113178124542660985ULL },
+	{  6041074626923081187ULL,  1690542499634128788ULL },
+	{ 12211557331022285596ULL,  1352433999707303030ULL },
+	{  1091747655926105338ULL,  2163894399531684849ULL },
+	{  4562746939482794594ULL,  1731115519625347879ULL },
+	{  7339546366328145998ULL,  1384892415700278303ULL },
+	{  8053925371383123274ULL,  2215827865120445285ULL },
+	{  6443140297106498619ULL,  1772662292096356228ULL },
+	{ 12533209867169019542ULL,  1418129833677084982ULL },
+	{  5295740528502789974ULL,  2269007733883335972ULL },
+	{ 15304638867027962949ULL,  1815206187106668777ULL },
+	{  4865013464138549713ULL,  1452164949685335022ULL },
+	{ 14960057215536570740ULL,  1161731959748268017ULL },
+	{  9178696285890871890ULL,  1858771135597228828ULL },
+	{ 14721654658196518159ULL,  1487016908477783062ULL },
+	{  4398626097073393881ULL,  1189613526782226450ULL },
+	{  7037801755317430209ULL,  1903381642851562320ULL },
+	{  5630241404253944167ULL,  1522705314281249856ULL },
+	{   814844308661245011ULL,  1218164251424999885ULL },
+	{  1303750893857992017ULL,  1949062802279999816ULL },
+	{ 15800395974054034906ULL,  1559250241823999852ULL },
+	{  5261619149759407279ULL,  1247400193459199882ULL },
+	{ 12107939454356961969ULL,  1995840309534719811ULL },
+	{  5997002748743659252ULL,  1596672247627775849ULL },
+	{  8486951013736837725ULL,  1277337798102220679ULL },
+	{  2511075177753209390ULL,  2043740476963553087ULL },
+	{ 13076906586428298482ULL,  1634992381570842469ULL },
+	{ 14150874083884549109ULL,  1307993905256673975ULL },
+	{  4194654460505726958ULL,  2092790248410678361ULL },
+	{ 18113118827372222859ULL,  1674232198728542688ULL },
+	{  3422448617672047318ULL,  1339385758982834151ULL },
+	{ 16543964232501006678ULL,  2143017214372534641ULL },
+	{  9545822571258895019ULL,  1714413771498027713ULL },
+	{ 15015355686490936662ULL,  1371531017198422170ULL },
+	{  5577825024675947042ULL,  2194449627517475473ULL },
+	{ 11840957649224578280ULL,  1755559702013980378ULL },
+	{ 16851463748863483271ULL,  1404447761611184302ULL },
+	{ 12204946739213931940ULL,  2247116418577894884ULL },
+	{ 13453306206113055875ULL,  1797693134862315907ULL },
+	{  3383947335406624054ULL,  1438154507889852726ULL },
+	{ 16482362180876329456ULL,  2301047212623764361ULL },
+	{  9496540929959153242ULL,  1840837770099011489ULL },
+	{ 11286581558709232917ULL,  1472670216079209191ULL },
+	{  5339916432225476010ULL,  1178136172863367353ULL },
+	{  4854517476818851293ULL,  1885017876581387765ULL },
+	{  3883613981455081034ULL,  1508014301265110212ULL },
+	{ 14174937629389795797ULL,  1206411441012088169ULL },
+	{ 11611853762797942306ULL,  1930258305619341071ULL },
+	{  5600134195496443521ULL,  1544206644495472857ULL },
+	{ 15548153800622885787ULL,  1235365315596378285ULL },
+	{  6430302007287065643ULL,  1976584504954205257ULL },
+	{ 16212288050055383484ULL,  1581267603963364205ULL },
+	{ 12969830440044306787ULL,  1265014083170691364ULL },
+	{  9683682259845159889ULL,  2024022533073106183ULL },
+	{ 15125643437359948558ULL,  1619218026458484946ULL },
+	{  8411165935146048523ULL,  1295374421166787957ULL },
+	{ 17147214310975587960ULL,  2072599073866860731ULL },
+	{ 10028422634038560045ULL,  1658079259093488585ULL },
+	{  8022738107230848036ULL,  1326463407274790868ULL },
+	{  9147032156827446534ULL,  2122341451639665389ULL },
+	{ 11006974540203867551ULL,  1697873161311732311ULL },
+	{  5116230817421183718ULL,  1358298529049385849ULL },
+	{ 15564666937357714594ULL,  2173277646479017358ULL },
+	{  1383687105660440706ULL,  1738622117183213887ULL },
+	{ 12174996128754083534ULL,  1390897693746571109ULL },
+	{  8411947361780802685ULL,  2225436309994513775ULL },
+	{  6729557889424642148ULL,  1780349047995611020ULL },
+	{  5383646311539713719ULL,  1424279238396488816ULL },
+	{  1235136468979721303ULL,  2278846781434382106ULL },
+	{ 15745504434151418335ULL,  1823077425147505684ULL },
+	{ 16285752362063044992ULL,  1458461940118004547ULL },
+	{  5649904260166615347ULL,  1166769552094403638ULL },
+	{  5350498001524674232ULL,  1866831283351045821ULL },
+	{   591049586477829062ULL,  1493465026680836657ULL },
+	{ 11540886113407994219ULL,  1194772021344669325ULL },
+	{    18673707743239135ULL,  1911635234151470921ULL },
+	{ 14772334225162232601ULL,  1529308187321176736ULL },
+	{  8128518565387875758ULL,  1223446549856941389ULL },
+	{  1937583260394870242ULL,  1957514479771106223ULL },
+	{  8928764237799716840ULL,  1566011583816884978ULL },
+	{ 14521709019723594119ULL,  1252809267053507982ULL },
+	{  8477339172590109297ULL,  2004494827285612772ULL },
+	{ 17849917782297818407ULL,  1603595861828490217ULL },
+	{  6901236596354434079ULL,  1282876689462792174ULL },
+	{ 18420676183650915173ULL,  2052602703140467478ULL },
+	{  3668494502695001169ULL,  1642082162512373983ULL },
+	{ 10313493231639821582ULL,  1313665730009899186ULL },
+	{  9122891541139893884ULL,  2101865168015838698ULL },
+	{ 14677010862395735754ULL,  1681492134412670958ULL },
+	{   673562245690857633ULL,  1345193707530136767ULL },
+};
+
+static const unsigned long long s_pow5split[326][2] = {
+	{                    0ULL,  1152921504606846976ULL },
+	{                    0ULL,  1441151880758558720ULL },
+	{                    0ULL,  1801439850948198400ULL },
+	{                    0ULL,  2251799813685248000ULL },
+	{                    0ULL,  1407374883553280000ULL },
+	{                    0ULL,  1759218604441600000ULL },
+	{                    0ULL,  2199023255552000000ULL },
+	{                    0ULL,  1374389534720000000ULL },
+	{                    0ULL,  1717986918400000000ULL },
+	{                    0ULL,  2147483648000000000ULL },
+	{                    0ULL,  1342177280000000000ULL },
+	{                    0ULL,  1677721600000000000ULL },
+	{                    0ULL,  2097152000000000000ULL },
+	{                    0ULL,  1310720000000000000ULL },
+	{                    0ULL,  1638400000000000000ULL },
+	{                    0ULL,  2048000000000000000ULL },
+	{                    0ULL,  1280000000000000000ULL },
+	{                    0ULL,  1600000000000000000ULL },
+	{                    0ULL,  2000000000000000000ULL },
+	{                    0ULL,  1250000000000000000ULL },
+	{                    0ULL,  1562500000000000000ULL },
+	{                    0ULL,  1953125000000000000ULL },
+	{                    0ULL,  1220703125000000000ULL },
+	{                    0ULL,  1525878906250000000ULL },
+	{                    0ULL,  1907348632812500000ULL },
+	{                    0ULL,  1192092895507812500ULL },
+	{                    0ULL,  1490116119384765625ULL },
+	{  4611686018427387904ULL,  1862645149230957031ULL },
+	{  9799832789158199296ULL,  1164153218269348144ULL },
+	{ 12249790986447749120ULL,  1455191522836685180ULL },
+	{ 15312238733059686400ULL,  1818989403545856475ULL },
+	{ 14528612397897220096ULL,  2273736754432320594ULL },
+	{ 13692068767113150464ULL,  1421085471520200371ULL },
+	{ 12503399940464050176ULL,  1776356839400250464ULL },
+	{ 15629249925580062720ULL,  2220446049250313080ULL },
+	{  9768281203487539200ULL,  1387778780781445675ULL },
+	{  7598665485932036096ULL,  1734723475976807094ULL },
+	{   274959820560269312ULL,  2168404344971008868ULL },
+	{  9395221924704944128ULL,  1355252715606880542ULL },
+	{  2520655369026404352ULL,  1694065894508600678ULL },
+	{ 12374191248137781248ULL,  2117582368135750847ULL },
+	{ 14651398557727195136ULL,  1323488980084844279ULL },
+	{ 13702562178731606016ULL,  1654361225106055349ULL },
+	{  3293144668132343808ULL,  2067951531382569187ULL },
+	{ 18199116482078572544ULL,  1292469707114105741ULL },
+	{  8913837547316051968ULL,  1615587133892632177ULL },
+	{ 15753982952572452864ULL,  2019483917365790221ULL },
+	{ 12152082354571476992ULL,  1262177448353618888ULL },
+	{ 15190102943214346240ULL,  1577721810442023610ULL },
+	{  9764256642163156992ULL,  1972152263052529513ULL },
+	{ 17631875447420442880ULL,  1232595164407830945ULL },
+	{  8204786253993389888ULL,  1540743955509788682ULL },
+	{  1032610780636961552ULL,  1925929944387235853ULL },
+	{  2951224747111794922ULL,  1203706215242022408ULL },
+	{  3689030933889743652ULL,  1504632769052528010ULL },
+	{ 13834660704216955373ULL,  1880790961315660012ULL },
+	{ 17870034976990372916ULL,  1175494350822287507ULL },
+	{ 17725857702810578241ULL,  1469367938527859384ULL },
+	{  3710578054803671186ULL,  1836709923159824231ULL },
+	{    26536550077201078ULL,  2295887403949780289ULL },
+	{ 11545800389866720434ULL,  1434929627468612680ULL },
+	{ 14432250487333400542ULL,  1793662034335765850ULL },
+	{  8816941072311974870ULL,  2242077542919707313ULL },
+	{ 17039803216263454053ULL,  1401298464324817070ULL },
+	{ 12076381983474541759ULL,  1751623080406021338ULL },
+	{  5872105442488401391ULL,  2189528850507526673ULL },
+	{ 15199280947623720629ULL,  1368455531567204170ULL },
+	{  9775729147674874978ULL,  1710569414459005213ULL },
+	{ 16831347453020981627ULL,  2138211768073756516ULL },
+	{  1296220121283337709ULL,  1336382355046097823ULL },
+	{ 15455333206886335848ULL,  1670477943807622278ULL },
+	{ 10095794471753144002ULL,  2088097429759527848ULL },
+	{  6309871544845715001ULL,  1305060893599704905ULL },
+	{ 12499025449484531656ULL,  1631326116999631131ULL },
+	{ 11012095793428276666ULL,  2039157646249538914ULL },
+	{ 11494245889320060820ULL,  1274473528905961821ULL },
+	{   532749306367912313ULL,  1593091911132452277ULL },
+	{  5277622651387278295ULL,  1991364888915565346ULL },
+	{  7910200175544436838ULL,  1244603055572228341ULL },
+	{ 14499436237857933952ULL,  1555753819465285426ULL },
+	{  8900923260467641632ULL,  1944692274331606783ULL },
+	{ 12480606065433357876ULL,  1215432671457254239ULL },
+	{ 10989071563364309441ULL,  1519290839321567799ULL },
+	{  9124653435777998898ULL,  1899113549151959749ULL },
+	{  8008751406574943263ULL,  1186945968219974843ULL },
+	{  5399253239791291175ULL,  1483682460274968554ULL },
+	{ 15972438586593889776ULL,  1854603075343710692ULL },
+	{   759402079766405302ULL,  1159126922089819183ULL },
+	{ 14784310654990170340ULL,  1448908652612273978ULL },
+	{  9257016281882937117ULL,  1811135815765342473ULL },
+	{ 16182956370781059300ULL,  2263919769706678091ULL },
+	{  7808504722524468110ULL,  1414949856066673807ULL },
+	{  5148944884728197234ULL,  1768687320083342259ULL },
+	{  1824495087482858639ULL,  2210859150104177824ULL },
+	{  1140309429676786649ULL,  1381786968815111140ULL },
+	{  1425386787095983311ULL,  1727233711018888925ULL },
+	{  6393419502297367043ULL,  2159042138773611156ULL },
+	{ 13219259225790630210ULL,  1349401336733506972ULL },
+	{ 16524074032238287762ULL,  1686751670916883715ULL },
+	{ 16043406521870471799ULL,  2108439588646104644ULL },
+	{   803757039314269066ULL,  1317774742903815403ULL },
+	{ 14839754354425000045ULL,  1647218428629769253ULL },
+	{  4714634887749086344ULL,  2059023035787211567ULL },
+	{  9864175832484260821ULL,  1286889397367007229ULL },
+	{ 16941905809032713930ULL,  1608611746708759036ULL },
+	{  2730638187581340797ULL,  2010764683385948796ULL },
+	{ 10930020904093113806ULL,  1256727927116217997ULL },
+	{ 18274212148543780162ULL,  1570909908895272496ULL },
+	{  4396021111970173586ULL,  1963637386119090621ULL },
+	{  5053356204195052443ULL,  1227273366324431638ULL },
+	{ 15540067292098591362ULL,  1534091707905539547ULL },
+	{ 14813398096695851299ULL,  1917614634881924434ULL },
+	{ 13870059828862294966ULL,  1198509146801202771ULL },
+	{ 12725888767650480803ULL,  1498136433501503464ULL },
+	{ 15907360959563101004ULL,  1872670541876879330ULL },
+	{ 14553786618154326031ULL,  1170419088673049581ULL },
+	{  4357175217410743827ULL,  1463023860841311977ULL },
+	{ 10058155040190817688ULL,  1828779826051639971ULL },
+	{  7961007781811134206ULL,  2285974782564549964ULL },
+	{ 14199001900486734687ULL,  1428734239102843727ULL },
+	{ 13137066357181030455ULL,  1785917798878554659ULL },
+	{ 11809646928048900164ULL,  2232397248598193324ULL },
+	{ 16604401366885338411ULL,  1395248280373870827ULL },
+	{ 16143815690179285109ULL,  1744060350467338534ULL },
+	{ 10956397575869330579ULL,  2180075438084173168ULL },
+	{  6847748484918331612ULL,  1362547148802608230ULL },
+	{ 17783057643002690323ULL,  1703183936003260287ULL },
+	{ 17617136035325974999ULL,  2128979920004075359ULL },
+	{ 17928239049719816230ULL,  1330612450002547099ULL },
+	{ 17798612793722382384ULL,  1663265562503183874ULL },
+	{ 13024893955298202172ULL,  2079081953128979843ULL },
+	{  5834715712847682405ULL,  1299426220705612402ULL },
+	{ 16516766677914378815ULL,  1624282775882015502ULL },
+	{ 11422586310538197711ULL,  2030353469852519378ULL },
+	{ 11750802462513761473ULL,  1268970918657824611ULL },
+	{ 10076817059714813937ULL,  1586213648322280764ULL },
+	{ 12596021324643517422ULL,  1982767060402850955ULL },
+	{  5566670318688504437ULL,  1239229412751781847ULL },
+	{  2346651879933242642ULL,  1549036765939727309ULL },
+	{  7545000868343941206ULL,  1936295957424659136ULL },
+	{  4715625542714963254ULL,  1210184973390411960ULL },
+	{  5894531928393704067ULL,  1512731216738014950ULL },
+	{ 16591536947346905892ULL,  1890914020922518687ULL },
+	{ 17287239619732898039ULL,  1181821263076574179ULL },
+	{ 16997363506238734644ULL,  1477276578845717724ULL },
+	{  2799960309088866689ULL,  1846595723557147156ULL },
+	{ 10973347230035317489ULL,  1154122327223216972ULL },
+	{ 13716684037544146861ULL,  1442652909029021215ULL },
+	{ 12534169028502795672ULL,  1803316136286276519ULL },
+	{ 11056025267201106687ULL,  2254145170357845649ULL },
+	{ 18439230838069161439ULL,  1408840731473653530ULL },
+	{ 13825666510731675991ULL,  1761050914342066913ULL },
+	{  3447025083132431277ULL,  2201313642927583642ULL },
+	{  6766076695385157452ULL,  1375821026829739776ULL },
+	{  8457595869231446815ULL,  1719776283537174720ULL },
+	{ 10571994836539308519ULL,  2149720354421468400ULL },
+	{  6607496772837067824ULL,  1343575221513417750ULL },
+	{ 17482743002901110588ULL,  1679469026891772187ULL },
+	{ 17241742735199000331ULL,  2099336283614715234ULL },
+	{ 15387775227926763111ULL,  1312085177259197021ULL },
+	{  5399660979626290177ULL,  1640106471573996277ULL },
+	{ 11361262242960250625ULL,  2050133089467495346ULL },
+	{ 11712474920277544544ULL,  1281333180917184591ULL },
+	{ 10028907631919542777ULL,  1601666476146480739ULL },
+	{  7924448521472040567ULL,  2002083095183100924ULL },
+	{ 14176152362774801162ULL,  1251301934489438077ULL },
+	{  3885132398186337741ULL,  1564127418111797597ULL },
+	{  9468101516160310080ULL,  1955159272639746996ULL },
+	{ 15140935484454969608ULL,  1221974545399841872ULL },
+	{   479425281859160394ULL,  1527468181749802341ULL },
+	{  5210967620751338397ULL,  1909335227187252926ULL },
+	{ 17091912818251750210ULL,  1193334516992033078ULL },
+	{ 12141518985959911954ULL,  1491668146240041348ULL },
+	{ 15176898732449889943ULL,  1864585182800051685ULL },
+	{ 11791404716994875166ULL,  1165365739250032303ULL },
+	{ 10127569877816206054ULL,  1456707174062540379ULL },
+	{  8047776328842869663ULL,  1820883967578175474ULL },
+	{   836348374198811271ULL,  2276104959472719343ULL },
+	{  7440246761515338900ULL,  1422565599670449589ULL },
+	{ 13911994470321561530ULL,  1778206999588061986ULL },
+	{  8166621051047176104ULL,  2222758749485077483ULL },
+	{  2798295147690791113ULL,  1389224218428173427ULL },
+	{ 17332926989895652603ULL,  1736530273035216783ULL },
+	{ 17054472718942177850ULL,  2170662841294020979ULL },
+	{  8353202440125167204ULL,  1356664275808763112ULL },
+	{ 10441503050156459005ULL,  1695830344760953890ULL },
+	{  3828506775840797949ULL,  2119787930951192363ULL },
+	{    86973725686804766ULL,  1324867456844495227ULL },
+	{ 13943775212390669669ULL,  1656084321055619033ULL },
+	{  3594660960206173375ULL,  2070105401319523792ULL },
+	{  2246663100128858359ULL,  1293815875824702370ULL },
+	{ 12031700912015848757ULL,  1617269844780877962ULL },
+	{  5816254103165035138ULL,  2021587305976097453ULL },
+	{  5941001823691840913ULL,  1263492066235060908ULL },
+	{  7426252279614801142ULL,  1579365082793826135ULL },
+	{  4671129331091113523ULL,  1974206353492282669ULL },
+	{  5225298841145639904ULL,  1233878970932676668ULL },
+	{  6531623551432049880ULL,  1542348713665845835ULL },
+	{  3552843420862674446ULL,  1927935892082307294ULL },
+	{ 16055585193321335241ULL,  1204959932551442058ULL },
+	{ 10846109454796893243ULL,  1506199915689302573ULL },
+	{ 18169322836923504458ULL,  1882749894611628216ULL },
+	{ 11355826773077190286ULL,  1176718684132267635ULL },
+	{  9583097447919099954ULL,  1470898355165334544ULL },
+	{ 11978871809898874942ULL,  1838622943956668180ULL },
+	{ 14973589762373593678ULL,  2298278679945835225ULL },
+	{  2440964573842414192ULL,  1436424174966147016ULL },
+	{  3051205717303017741ULL,  1795530218707683770ULL },
+	{ 13037379183483547984ULL,  2244412773384604712ULL },
+	{  8148361989677217490ULL,  1402757983365377945ULL },
+	{ 14797138505523909766ULL,  1753447479206722431ULL },
+	{ 13884737113477499304ULL,  2191809349008403039ULL },
+	{ 15595489723564518921ULL,  1369880843130251899ULL },
+	{ 14882676136028260747ULL,  1712351053912814874ULL },
+	{  9379973133180550126ULL,  2140438817391018593ULL },
+	{ 17391698254306313589ULL,  1337774260869386620ULL },
+	{  3292878744173340370ULL,  1672217826086733276ULL },
+	{  4116098430216675462ULL,  2090272282608416595ULL },
+	{   266718509671728212ULL,  1306420176630260372ULL },
+	{   333398137089660265ULL,  1633025220787825465ULL },
+	{  5028433689789463235ULL,  2041281525984781831ULL },
+	{ 10060300083759496378ULL,  1275800953740488644ULL },
+	{ 12575375104699370472ULL,  1594751192175610805ULL },
+	{  1884160825592049379ULL,  1993438990219513507ULL },
+	{ 17318501580490888525ULL,  1245899368887195941ULL },
+	{  7813068920331446945ULL,  1557374211108994927ULL },
+	{  5154650131986920777ULL,  1946717763886243659ULL },
+	{   915813323278131534ULL,  1216698602428902287ULL },
+	{ 14979824709379828129ULL,  1520873253036127858ULL },
+	{  9501408849870009354ULL,  1901091566295159823ULL },
+	{ 12855909558809837702ULL,  1188182228934474889ULL },
+	{  2234828893230133415ULL,  1485227786168093612ULL },
+	{  2793536116537666769ULL,  1856534732710117015ULL },
+	{  8663489100477123587ULL,  1160334207943823134ULL },
+	{  1605989338741628675ULL,  1450417759929778918ULL },
+	{ 11230858710281811652ULL,  1813022199912223647ULL },
+	{  9426887369424876662ULL,  2266277749890279559ULL },
+	{ 12809333633531629769ULL,  1416423593681424724ULL },
+	{ 16011667041914537212ULL,  1770529492101780905ULL },
+	{  6179525747111007803ULL,  2213161865127226132ULL },
+	{ 13085575628799155685ULL,  1383226165704516332ULL },
+	{ 16356969535998944606ULL,  1729032707130645415ULL },
+	{ 15834525901571292854ULL,  2161290883913306769ULL },
+	{  2979049660840976177ULL,  1350806802445816731ULL },
+	{ 17558870131333383934ULL,  1688508503057270913ULL },
+	{  8113529608884566205ULL,  2110635628821588642ULL },
+	{  9682642023980241782ULL,  1319147268013492901ULL },
+	{ 16714988548402690132ULL,  1648934085016866126ULL },
+	{ 11670363648648586857ULL,  2061167606271082658ULL },
+	{ 11905663298832754689ULL,  1288229753919426661ULL },
+	{  1047021068258779650ULL,  1610287192399283327ULL },
+	{ 15143834390605638274ULL,  2012858990499104158ULL },
+	{  4853210475701136017ULL,  1258036869061940099ULL },
+	{  1454827076199032118ULL,  1572546086327425124ULL },
+	{  1818533845248790147ULL,  1965682607909281405ULL },
+	{  3442426662494187794ULL,  1228551629943300878ULL },
+	{ 13526405364972510550ULL,  1535689537429126097ULL },
+	{  3072948650933474476ULL,  1919611921786407622ULL },
+	{ 15755650962115585259ULL,  1199757451116504763ULL },
+	{ 15082877684217093670ULL,  1499696813895630954ULL },
+	{  9630225068416591280ULL,  1874621017369538693ULL },
+	{  8324733676974063502ULL,  1171638135855961683ULL },
+	{  5794231077790191473ULL,  1464547669819952104ULL },
+	{  7242788847237739342ULL,  1830684587274940130ULL },
+	{ 18276858095901949986ULL,  2288355734093675162ULL },
+	{ 16034722328366106645ULL,  1430222333808546976ULL },
+	{  1596658836748081690ULL,  1787777917260683721ULL },
+	{  6607509564362490017ULL,  2234722396575854651ULL },
+	{  1823850468512862308ULL,  1396701497859909157ULL },
+	{  6891499104068465790ULL,  1745876872324886446ULL },
+	{ 17837745916940358045ULL,  2182346090406108057ULL },
+	{  4231062170446641922ULL,  1363966306503817536ULL },
+	{  5288827713058302403ULL,  1704957883129771920ULL },
+	{  6611034641322878003ULL,  2131197353912214900ULL },
+	{ 13355268687681574560ULL,  1331998346195134312ULL },
+	{ 16694085859601968200ULL,  1664997932743917890ULL },
+	{ 11644235287647684442ULL,  2081247415929897363ULL },
+	{  4971804045566108824ULL,  1300779634956185852ULL },
+	{  6214755056957636030ULL,  1625974543695232315ULL },
+	{  3156757802769657134ULL,  2032468179619040394ULL },
+	{  6584659645158423613ULL,  1270292612261900246ULL },
+	{ 17454196593302805324ULL,  1587865765327375307ULL },
+	{ 17206059723201118751ULL,  1984832206659219134ULL },
+	{  6142101308573311315ULL,  1240520129162011959ULL },
+	{  3065940617289251240ULL,  1550650161452514949ULL },
+	{  8444111790038951954ULL,  1938312701815643686ULL },
+	{   665883850346957067ULL,  1211445438634777304ULL },
+	{   832354812933696334ULL,  1514306798293471630ULL },
+	{ 10263815553021896226ULL,  1892883497866839537ULL },
+	{ 17944099766707154901ULL,  1183052186166774710ULL },
+	{ 13206752671529167818ULL,  1478815232708468388ULL },
+	{ 16508440839411459773ULL,  1848519040885585485ULL },
+	{ 12623618533845856310ULL,  1155324400553490928ULL },
+	{ 15779523167307320387ULL,  1444155500691863660ULL },
+	{  1277659885424598868ULL,  1805194375864829576ULL },
+	{  1597074856780748586ULL,  2256492969831036970ULL },
+	{  5609857803915355770ULL,  1410308106144398106ULL },
+	{ 16235694291748970521ULL,  1762885132680497632ULL },
+	{  1847873790976661535ULL,  2203606415850622041ULL },
+	{ 12684136165428883219ULL,  1377254009906638775ULL },
+	{ 11243484188358716120ULL,  1721567512383298469ULL },
+	{   219297180166231438ULL,  2151959390479123087ULL },
+	{  7054589765244976505ULL,  1344974619049451929ULL },
+	{ 13429923224983608535ULL,  1681218273811814911ULL },
+	{ 12175718012802122765ULL,  2101522842264768639ULL },
+	{ 14527352785642408584ULL,  1313451776415480399ULL },
+	{ 13547504963625622826ULL,  1641814720519350499ULL },
+	{ 12322695186104640628ULL,  2052268400649188124ULL },
+	{ 16925056528170176201ULL,  1282667750405742577ULL },
+	{  7321262604930556539ULL,  1603334688007178222ULL },
+	{ 18374950293017971482ULL,  2004168360008972777ULL },
+	{  4566814905495150320ULL,  1252605225005607986ULL },
+	{ 14931890668723713708ULL,  1565756531257009982ULL },
+	{  9441491299049866327ULL,  1957195664071262478ULL },
+	{  1289246043478778550ULL,  1223247290044539049ULL },
+	{  6223243572775861092ULL,  1529059112555673811ULL },
+	{  3167368447542438461ULL,  1911323890694592264ULL },
+	{  1979605279714024038ULL,  1194577431684120165ULL },
+	{  7086192618069917952ULL,  1493221789605150206ULL },
+	{ 18081112809442173248ULL,  1866527237006437757ULL },
+	{ 13606538515115052232ULL,  1166579523129023598ULL },
+	{  7784801107039039482ULL,  1458224403911279498ULL },
+	{   507629346944023544ULL,  1822780504889099373ULL },
+	{  5246222702107417334ULL,  2278475631111374216ULL },
+	{  3278889188817135834ULL,  1424047269444608885ULL },
+	{  8710297504448807696ULL,  1780059086805761106ULL },
+};
+
+// 5^q for q in [-342, 308] as 128 bit numbers with the top bit set, low half
+// first, for Eisel-Lemire parsing. Generated as fast_float does: the top
+// 128 bits of 5^q, and 2^b / 5^-q + 1 truncated to 128 bits for negative q
+static const unsigned long long s_pow5_128[651][2] = {
+	{  1242899115359157055ULL, 17218479456385750618ULL },
+	{  5388497965526861063ULL, 10761549660241094136ULL },
+	{  6735622456908576329ULL, 13451937075301367670ULL },
+	{ 17642900107990496220ULL, 16814921344126709587ULL },
+	{  8720969558280366185ULL, 10509325840079193492ULL },
+	{ 10901211947850457732ULL, 13136657300098991865ULL },
+	{ 18238200953240460069ULL, 16420821625123739831ULL },
+	{ 18316404623416369399ULL, 10263013515702337394ULL },
+	{ 13672133742415685941ULL, 12828766894627921743ULL },
+	{ 12478481159592219522ULL, 16035958618284902179ULL },
+	{  5493207715531443249ULL, 10022474136428063862ULL },
+	{ 16089881681269079869ULL, 12528092670535079827ULL },
+	{ 15500666083158961933ULL, 15660115838168849784ULL },
+	{  9687916301974351208ULL,  9787572398855531115ULL },
+	{  7498209359040551106ULL, 12234465498569413894ULL },
+	{   149389661945913074ULL, 15293081873211767368ULL },
+	{    93368538716195671ULL,  9558176170757354605ULL },
+	{  4728396691822632493ULL, 11947720213446693256ULL },
+	{  5910495864778290617ULL, 14934650266808366570ULL },
+	{  8305745933913819539ULL,  9334156416755229106ULL },
+	{  1158810380537498616ULL, 11667695520944036383ULL },
+	{ 15283571030954036982ULL, 14584619401180045478ULL },
+	{  9881091751837770420ULL, 18230774251475056848ULL },
+	{  6175682344898606512ULL, 11394233907171910530ULL },
+	{ 16942974967978033949ULL, 14242792383964888162ULL },
+	{ 11955346673117766628ULL, 17803490479956110203ULL },
+	{  5166248661484910190ULL, 11127181549972568877ULL },
+	{ 11069496845283525642ULL, 13908976937465711096ULL },
+	{ 13836871056604407053ULL, 17386221171832138870ULL },
+	{  4036358391950366504ULL, 10866388232395086794ULL },
+	{ 14268820026792733938ULL, 13582985290493858492ULL },
+	{ 17836025033490917422ULL, 16978731613117323115ULL },
+	{  8841672636718129437ULL, 10611707258198326947ULL },
+	{  6440404777470273892ULL, 13264634072747908684ULL },
+	{  8050505971837842365ULL, 16580792590934885855ULL },
+	{ 11949095260039733334ULL, 10362995369334303659ULL },
+	{ 10324683056622278764ULL, 12953744211667879574ULL },
+	{  3682481783923072647ULL, 16192180264584849468ULL },
+	{ 11524923151806696212ULL, 10120112665365530917ULL },
+	{   571095884476206553ULL, 12650140831706913647ULL },
+	{ 14548927910877421904ULL, 15812676039633642058ULL },
+	{ 13704765962725776594ULL,  9882922524771026286ULL },
+	{  7907585416552444934ULL, 12353653155963782858ULL },
+	{   661109733835780360ULL, 15442066444954728573ULL },
+	{  2719036592861056677ULL,  9651291528096705358ULL },
+	{ 12622167777931096654ULL, 12064114410120881697ULL },
+	{  1942651667131707105ULL, 15080143012651102122ULL },
+	{  5825843310384704845ULL,  9425089382906938826ULL },
+	{ 16505676174835656864ULL, 11781361728633673532ULL },
+	{  2185351144835019464ULL, 14726702160792091916ULL },
+	{  2731688931043774330ULL, 18408377700990114895ULL },
+	{  8624834609543440812ULL, 11505236063118821809ULL },
+	{ 15392729280356688919ULL, 14381545078898527261ULL },
+	{  5405853545163697437ULL, 17976931348623159077ULL },
+	{  5684501474941004850ULL, 11235582092889474423ULL },
+	{  2493940825248868159ULL, 14044477616111843029ULL },
+	{  7729112049988473103ULL, 17555597020139803786ULL },
+	{  9442381049670183593ULL, 10972248137587377366ULL },
+	{  2579604275232953683ULL, 13715310171984221708ULL },
+	{  3224505344041192104ULL, 17144137714980277135ULL },
+	{  8932844867666826921ULL, 10715086071862673209ULL },
+	{ 15777742103010921555ULL, 13393857589828341511ULL },
+	{ 15110491610336264040ULL, 16742321987285426889ULL },
+	{  2526528228819083169ULL, 10463951242053391806ULL },
+	{ 12381532322878629770ULL, 13079939052566739757ULL },
+	{  1641857348316123500ULL, 16349923815708424697ULL },
+	{ 12555375888766046947ULL, 10218702384817765435ULL },
+	{ 11082533842530170780ULL, 12773377981022206794ULL },
+	{  4629795266307937667ULL, 15966722476277758493ULL },
+	{  5199465050656154994ULL,  9979201547673599058ULL },
+	{ 15722703350174969551ULL, 12474001934591998822ULL },
+	{ 10430007150863936130ULL, 15592502418239998528ULL },
+	{  6518754469289960081ULL,  9745314011399999080ULL },
+	{  8148443086612450102ULL, 12181642514249998850ULL },
+	{   962181821410786819ULL, 15227053142812498563ULL },
+	{ 16742264702877599426ULL,  9516908214257811601ULL },
+	{  7092772823314835570ULL, 11896135267822264502ULL },
+	{ 18089338065998320271ULL, 14870169084777830627ULL },
+	{  8999993282035256217ULL,  9293855677986144142ULL },
+	{  2026619565689294464ULL, 11617319597482680178ULL },
+	{ 11756646493966393888ULL, 14521649496853350222ULL },
+	{  5472436080603216552ULL, 18152061871066687778ULL },
+	{  8031958568804398249ULL, 11345038669416679861ULL },
+	{ 14651634229432885715ULL, 14181298336770849826ULL },
+	{  9091170749936331336ULL, 17726622920963562283ULL },
+	{  3376138709496513133ULL, 11079139325602226427ULL },
+	{ 18055231442152805128ULL, 13848924157002783033ULL },
+	{  8733981247408842698ULL, 17311155196253478792ULL },
+	{  5458738279630526686ULL, 10819471997658424245ULL },
+	{ 11435108867965546262ULL, 13524339997073030306ULL },
+	{  5070514048102157020ULL, 16905424996341287883ULL },
+	{   863228270850154185ULL, 10565890622713304927ULL },
+	{ 14914093393844856443ULL, 13207363278391631158ULL },
+	{  9419244705451294746ULL, 16509204097989538948ULL },
+	{ 15110399977761835024ULL, 10318252561243461842ULL },
+	{  9664627935347517973ULL, 12897815701554327303ULL },
+	{  7469098900757009562ULL, 16122269626942909129ULL },
+	{ 16197401859041600736ULL, 10076418516839318205ULL },
+	{  6411694268519837208ULL, 12595523146049147757ULL },
+	{ 12626303854077184414ULL, 15744403932561434696ULL },
+	{  7891439908798240259ULL,  9840252457850896685ULL },
+	{ 14475985904425188227ULL, 12300315572313620856ULL },
+	{ 18094982380531485284ULL, 15375394465392026070ULL },
+	{  6697677969404790399ULL,  9609621540870016294ULL },
+	{ 17595469498610763806ULL, 12012026926087520367ULL },
+	{ 17382650854836066854ULL, 15015033657609400459ULL },
+	{  8558313775058847832ULL,  9384396036005875287ULL },
+	{  6086206200396171886ULL, 11730495045007344109ULL },
+	{ 12219443768922602761ULL, 14663118806259180136ULL },
+	{ 15274304711153253452ULL, 18328898507823975170ULL },
+	{ 14158126462898171311ULL, 11455561567389984481ULL },
+	{  3862600023340550427ULL, 14319451959237480602ULL },
+	{ 14051622066030463842ULL, 17899314949046850752ULL },
+	{  8782263791269039901ULL, 11187071843154281720ULL },
+	{ 10977829739086299876ULL, 13983839803942852150ULL },
+	{  4498915137003099037ULL, 17479799754928565188ULL },
+	{ 12035193997481712706ULL, 10924874846830353242ULL },
+	{  5820620459997365075ULL, 13656093558537941553ULL },
+	{ 11887461593424094248ULL, 17070116948172426941ULL },
+	{  9735506505103752857ULL, 10668823092607766838ULL },
+	{  2946011094524915263ULL, 13336028865759708548ULL },
+	{  3682513868156144079ULL, 16670036082199635685ULL },
+	{  4607414176811284001ULL, 10418772551374772303ULL },
+	{  1147581702586717097ULL, 13023465689218465379ULL },
+	{ 15269535183515560084ULL, 16279332111523081723ULL },
+	{  7237616480483531100ULL, 10174582569701926077ULL },
+	{ 13658706619031801779ULL, 12718228212127407596ULL },
+	{ 17073383273789752224ULL, 15897785265159259495ULL },
+	{ 17588393573759676996ULL,  9936115790724537184ULL },
+	{  3538747893490044629ULL, 12420144738405671481ULL },
+	{  9035120885289943691ULL, 15525180923007089351ULL },
+	{ 12564479580947296663ULL,  9703238076879430844ULL },
+	{ 15705599476184120828ULL, 12129047596099288555ULL },
+	{ 15020313326802763131ULL, 15161309495124110694ULL },
+	{  4776009810824339053ULL,  9475818434452569184ULL },
+	{  5970012263530423816ULL, 11844773043065711480ULL },
+	{  7462515329413029771ULL, 14805966303832139350ULL },
+	{    52386062455755702ULL,  9253728939895087094ULL },
+	{  9288854614924470436ULL, 11567161174868858867ULL },
+	{  6999382250228200141ULL, 14458951468586073584ULL },
+	{  8749227812785250177ULL, 18073689335732591980ULL },
+	{ 14691639419845557168ULL, 11296055834832869987ULL },
+	{ 13752863256379558556ULL, 14120069793541087484ULL },
+	{ 17191079070474448196ULL, 17650087241926359355ULL },
+	{  8438581409832836170ULL, 11031304526203974597ULL },
+	{ 15159912780718433117ULL, 13789130657754968246ULL },
+	{  9726518939043265588ULL, 17236413322193710308ULL },
+	{ 15302446373756816800ULL, 10772758326371068942ULL },
+	{  9904685930341245193ULL, 13465947907963836178ULL },
+	{  3157485376071780683ULL, 16832434884954795223ULL },
+	{  8890957387685944783ULL, 10520271803096747014ULL },
+	{  1890324697752655170ULL, 13150339753870933768ULL },
+	{  2362905872190818963ULL, 16437924692338667210ULL },
+	{  6088502188546649756ULL, 10273702932711667006ULL },
+	{ 16833999772538088003ULL, 12842128665889583757ULL },
+	{  7207441660390446292ULL, 16052660832361979697ULL },
+	{ 16033866083812498692ULL, 10032913020226237310ULL },
+	{ 10818960567910847557ULL, 12541141275282796638ULL },
+	{  4300328673033783639ULL, 15676426594103495798ULL },
+	{ 16522763475928278486ULL,  9797766621314684873ULL },
+	{  6818396289628184396ULL, 12247208276643356092ULL },
+	{  8522995362035230495ULL, 15309010345804195115ULL },
+	{  3021029092058325107ULL,  9568131466127621947ULL },
+	{ 17611344420355070096ULL, 11960164332659527433ULL },
+	{  8179122470161673908ULL, 14950205415824409292ULL },
+	{ 14335323580705822000ULL,  9343878384890255807ULL },
+	{ 13307468457454889596ULL, 11679847981112819759ULL },
+	{ 12022649553391224092ULL, 14599809976391024699ULL },
+	{ 10416625923311642211ULL, 18249762470488780874ULL },
+	{ 11122077220497164286ULL, 11406101544055488046ULL },
+	{  4679224488766679549ULL, 14257626930069360058ULL },
+	{ 15072402647813125244ULL, 17822033662586700072ULL },
+	{  9420251654883203278ULL, 11138771039116687545ULL },
+	{ 16387000587031392001ULL, 13923463798895859431ULL },
+	{ 15872064715361852097ULL, 17404329748619824289ULL },
+	{  3002511419460075705ULL, 10877706092887390181ULL },
+	{  8364825292752482535ULL, 13597132616109237726ULL },
+	{  1232659579085827361ULL, 16996415770136547158ULL },
+	{ 14605470292210805812ULL, 10622759856335341973ULL },
+	{  4421779809981343554ULL, 13278449820419177467ULL },
+	{   915538744049291538ULL, 16598062275523971834ULL },
+	{  5183897733458195115ULL, 10373788922202482396ULL },
+	{  6479872166822743894ULL, 12967236152753102995ULL },
+	{  3488154190101041964ULL, 16209045190941378744ULL },
+	{  2180096368813151227ULL, 10130653244338361715ULL },
+	{ 16560178516298602746ULL, 12663316555422952143ULL },
+	{ 16088537126945865529ULL, 15829145694278690179ULL },
+	{  7749492695127472003ULL,  9893216058924181362ULL },
+	{   463493832054564196ULL, 12366520073655226703ULL },
+	{ 14414425345350368957ULL, 15458150092069033378ULL },
+	{ 13620701859271368502ULL,  9661343807543145861ULL },
+	{  3190819268807046916ULL, 12076679759428932327ULL },
+	{ 17823582141290972357ULL, 15095849699286165408ULL },
+	{ 11139738838306857723ULL,  9434906062053853380ULL },
+	{ 13924673547883572154ULL, 11793632577567316725ULL },
+	{  3570783879572301480ULL, 14742040721959145907ULL },
+	{ 18298537904747540562ULL, 18427550902448932383ULL },
+	{ 18354115218108294707ULL, 11517219314030582739ULL },
+	{ 18330958004207980480ULL, 14396524142538228424ULL },
+	{  4466953431550423984ULL, 17995655178172785531ULL },
+	{   486002885505321038ULL, 11247284486357990957ULL },
+	{  5219189625309039202ULL, 14059105607947488696ULL },
+	{  6523987031636299002ULL, 17573882009934360870ULL },
+	{ 17912549950054850588ULL, 10983676256208975543ULL },
+	{ 17779001419141175331ULL, 13729595320261219429ULL },
+	{  8388693718644305452ULL, 17161994150326524287ULL },
+	{ 12160462601793772764ULL, 10726246343954077679ULL },
+	{ 10588892233814828051ULL, 13407807929942597099ULL },
+	{  8624429273841147159ULL, 16759759912428246374ULL },
+	{   778582277723329070ULL, 10474849945267653984ULL },
+	{   973227847154161338ULL, 13093562431584567480ULL },
+	{  1216534808942701673ULL, 16366953039480709350ULL },
+	{ 14595392310871352257ULL, 10229345649675443343ULL },
+	{ 13632554370161802418ULL, 12786682062094304179ULL },
+	{ 12429006944274865118ULL, 15983352577617880224ULL },
+	{  7768129340171790699ULL,  9989595361011175140ULL },
+	{  9710161675214738374ULL, 12486994201263968925ULL },
+	{ 16749388112445810871ULL, 15608742751579961156ULL },
+	{  1244995533423855986ULL,  9755464219737475723ULL },
+	{ 15391302472061983695ULL, 12194330274671844653ULL },
+	{  5404070034795315907ULL, 15242912843339805817ULL },
+	{ 14906758817815542202ULL,  9526820527087378635ULL },
+	{ 14021762503842039848ULL, 11908525658859223294ULL },
+	{  8303831092947774002ULL, 14885657073574029118ULL },
+	{   578208414664970847ULL,  9303535670983768199ULL },
+	{ 14557818573613377271ULL, 11629419588729710248ULL },
+	{ 18197273217016721589ULL, 14536774485912137810ULL },
+	{ 13523219484416126178ULL, 18170968107390172263ULL },
+	{ 15369541205401160717ULL, 11356855067118857664ULL },
+	{   765182433041899281ULL, 14196068833898572081ULL },
+	{  5568164059729762005ULL, 17745086042373215101ULL },
+	{  5785945546544795205ULL, 11090678776483259438ULL },
+	{ 16455803970035769814ULL, 13863348470604074297ULL },
+	{  6734696907262548556ULL, 17329185588255092872ULL },
+	{  4209185567039092847ULL, 10830740992659433045ULL },
+	{  9873167977226253963ULL, 13538426240824291306ULL },
+	{  3118087934678041646ULL, 16923032801030364133ULL },
+	{  4254647968387469981ULL, 10576895500643977583ULL },
+	{   706623942056949572ULL, 13221119375804971979ULL },
+	{ 14718337982853350677ULL, 16526399219756214973ULL },
+	{ 11504804248497038125ULL, 10328999512347634358ULL },
+	{  5157633273766521849ULL, 12911249390434542948ULL },
+	{  6447041592208152311ULL, 16139061738043178685ULL },
+	{  6335244004343789146ULL, 10086913586276986678ULL },
+	{ 17142427042284512241ULL, 12608641982846233347ULL },
+	{ 16816347784428252397ULL, 15760802478557791684ULL },
+	{  1286845328412881940ULL,  9850501549098619803ULL },
+	{ 15443614715798266137ULL, 12313126936373274753ULL },
+	{  5469460339465668959ULL, 15391408670466593442ULL },
+	{  8030098730593431003ULL,  9619630419041620901ULL },
+	{ 14649309431669176658ULL, 12024538023802026126ULL },
+	{  9088264752731695015ULL, 15030672529752532658ULL },
+	{ 10291851488884697288ULL,  9394170331095332911ULL },
+	{  8253128342678483706ULL, 11742712913869166139ULL },
+	{  5704724409920716729ULL, 14678391142336457674ULL },
+	{ 16354277549255671720ULL, 18347988927920572092ULL },
+	{   998051431430019017ULL, 11467493079950357558ULL },
+	{ 10470936326142299579ULL, 14334366349937946947ULL },
+	{  8476984389250486570ULL, 17917957937422433684ULL },
+	{ 14521487280136329914ULL, 11198723710889021052ULL },
+	{ 18151859100170412392ULL, 13998404638611276315ULL },
+	{ 18078137856785627587ULL, 17498005798264095394ULL },
+	{ 15910522178918405146ULL, 10936253623915059621ULL },
+	{  6053094668365842720ULL, 13670317029893824527ULL },
+	{  2954682317029915496ULL, 17087896287367280659ULL },
+	{ 17987577512639554849ULL, 10679935179604550411ULL },
+	{ 17872785872372055657ULL, 13349918974505688014ULL },
+	{ 13117610303610293764ULL, 16687398718132110018ULL },
+	{ 12810192458183821506ULL, 10429624198832568761ULL },
+	{  2177682517447613171ULL, 13037030248540710952ULL },
+	{  2722103146809516464ULL, 16296287810675888690ULL },
+	{  6313000485183335694ULL, 10185179881672430431ULL },
+	{  3279564588051781713ULL, 12731474852090538039ULL },
+	{ 17934513790346890853ULL, 15914343565113172548ULL },
+	{  1985699082112030975ULL,  9946464728195732843ULL },
+	{ 16317181907922202431ULL, 12433080910244666053ULL },
+	{  6561419329620589327ULL, 15541351137805832567ULL },
+	{ 11018416108653950185ULL,  9713344461128645354ULL },
+	{  4549648098962661924ULL, 12141680576410806693ULL },
+	{ 10298746142130715309ULL, 15177100720513508366ULL },
+	{  1825030320404309164ULL,  9485687950320942729ULL },
+	{  6892973918932774359ULL, 11857109937901178411ULL },
+	{  4004531380238580045ULL, 14821387422376473014ULL },
+	{ 16337890167931276240ULL,  9263367138985295633ULL },
+	{  6587304654631931588ULL, 11579208923731619542ULL },
+	{ 17457502855144690293ULL, 14474011154664524427ULL },
+	{ 17210192550503474962ULL, 18092513943330655534ULL },
+	{  6144684325637283947ULL, 11307821214581659709ULL },
+	{ 12292541425473992838ULL, 14134776518227074636ULL },
+	{ 15365676781842491048ULL, 17668470647783843295ULL },
+	{ 16521077016292638761ULL, 11042794154864902059ULL },
+	{ 16039660251938410547ULL, 13803492693581127574ULL },
+	{ 10826203278068237376ULL, 17254365866976409468ULL },
+	{ 15989749085647424168ULL, 10783978666860255917ULL },
+	{  6152128301777116498ULL, 13479973333575319897ULL },
+	{ 12301846395648783526ULL, 16849966666969149871ULL },
+	{ 14606183024921571560ULL, 10531229166855718669ULL },
+	{  4422670725869800738ULL, 13164036458569648337ULL },
+	{ 10140024425764638826ULL, 16455045573212060421ULL },
+	{  8643358275316593218ULL, 10284403483257537763ULL },
+	{  6192511825718353619ULL, 12855504354071922204ULL },
+	{  7740639782147942024ULL, 16069380442589902755ULL },
+	{  2532056854628769813ULL, 10043362776618689222ULL },
+	{ 12388443105140738074ULL, 12554203470773361527ULL },
+	{ 10873867862998534689ULL, 15692754338466701909ULL },
+	{  9102010423587778132ULL,  9807971461541688693ULL },
+	{ 15989199047912110569ULL, 12259964326927110866ULL },
+	{ 10763126773035362404ULL, 15324955408658888583ULL },
+	{ 13644483260788183358ULL,  9578097130411805364ULL },
+	{ 17055604075985229198ULL, 11972621413014756705ULL },
+	{  7484447039699372786ULL, 14965776766268445882ULL },
+	{  9289465418239495895ULL,  9353610478917778676ULL },
+	{ 11611831772799369869ULL, 11692013098647223345ULL },
+	{   679731660717048624ULL, 14615016373309029182ULL },
+	{ 10073036612751086588ULL, 18268770466636286477ULL },
+	{  8601490892183123070ULL, 11417981541647679048ULL },
+	{ 10751863615228903838ULL, 14272476927059598810ULL },
+	{  4216457482181353989ULL, 17840596158824498513ULL },
+	{ 14164500972431816003ULL, 11150372599265311570ULL },
+	{  8482254178684994196ULL, 13937965749081639463ULL },
+	{  5991131704928854841ULL, 17422457186352049329ULL },
+	{ 15273672361649004036ULL, 10889035741470030830ULL },
+	{  9868718415206479237ULL, 13611294676837538538ULL },
+	{  3112525982153323238ULL, 17014118346046923173ULL },
+	{  4251171748059520976ULL, 10633823966279326983ULL },
+	{   702278666647013315ULL, 13292279957849158729ULL },
+	{  5489534351736154548ULL, 16615349947311448411ULL },
+	{  1125115960621402641ULL, 10384593717069655257ULL },
+	{  6018080969204141205ULL, 12980742146337069071ULL },
+	{  2910915193077788602ULL, 16225927682921336339ULL },
+	{ 17960223060169475540ULL, 10141204801825835211ULL },
+	{ 17838592806784456521ULL, 12676506002282294014ULL },
+	{ 13074868971625794844ULL, 15845632502852867518ULL },
+	{  3560107088838733873ULL,  9903520314283042199ULL },
+	{ 18285191916330581054ULL, 12379400392853802748ULL },
+	{  4409745821703674701ULL, 15474250491067253436ULL },
+	{ 11979463175419572496ULL,  9671406556917033397ULL },
+	{  1139270913992301908ULL, 12089258196146291747ULL },
+	{ 15259146697772541097ULL, 15111572745182864683ULL },
+	{  7231123676894144234ULL,  9444732965739290427ULL },
+	{  4427218577690292388ULL, 11805916207174113034ULL },
+	{ 14757395258967641293ULL, 14757395258967641292ULL },
+	{                    0ULL,  9223372036854775808ULL },
+	{                    0ULL, 11529215046068469760ULL },
+	{                    0ULL, 14411518807585587200ULL },
+	{                    0ULL, 18014398509481984000ULL },
+	{                    0ULL, 11258999068426240000ULL },
+	{                    0ULL, 14073748835532800000ULL },
+	{                    0ULL, 17592186044416000000ULL },
+	{                    0ULL, 10995116277760000000ULL },
+	{                    0ULL, 13743895347200000000ULL },
+	{                    0ULL, 17179869184000000000ULL },
+	{                    0ULL, 10737418240000000000ULL },
+	{                    0ULL, 13421772800000000000ULL },
+	{                    0ULL, 16777216000000000000ULL },
+	{                    0ULL, 10485760000000000000ULL },
+	{                    0ULL, 13107200000000000000ULL },
+	{                    0ULL, 16384000000000000000ULL },
+	{                    0ULL, 10240000000000000000ULL },
+	{                    0ULL, 12800000000000000000ULL },
+	{                    0ULL, 16000000000000000000ULL },
+	{                    0ULL, 10000000000000000000ULL },
+	{                    0ULL, 12500000000000000000ULL },
+	{                    0ULL, 15625000000000000000ULL },
+	{                    0ULL,  9765625000000000000ULL },
+	{                    0ULL, 12207031250000000000ULL },
+	{                    0ULL, 15258789062500000000ULL },
+	{                    0ULL,  9536743164062500000ULL },
+	{                    0ULL, 11920928955078125000ULL },
+	{                    0ULL, 14901161193847656250ULL },
+	{  4611686018427387904ULL,  9313225746154785156ULL },
+	{  5764607523034234880ULL, 11641532182693481445ULL },
+	{ 11817445422220181504ULL, 14551915228366851806ULL },
+	{  5548434740920451072ULL, 18189894035458564758ULL },
+	{ 17302829768357445632ULL, 11368683772161602973ULL },
+	{  7793479155164643328ULL, 14210854715202003717ULL },
+	{ 14353534962383192064ULL, 17763568394002504646ULL },
+	{  4359273333062107136ULL, 11102230246251565404ULL },
+	{  5449091666327633920ULL, 13877787807814456755ULL },
+	{  2199678564482154496ULL, 17347234759768070944ULL },
+	{  1374799102801346560ULL, 10842021724855044340ULL },
+	{  1718498878501683200ULL, 13552527156068805425ULL },
+	{  6759809616554491904ULL, 16940658945086006781ULL },
+	{  6530724019560251392ULL, 10587911840678754238ULL },
+	{ 17386777061305090048ULL, 13234889800848442797ULL },
+	{  7898413271349198848ULL, 16543612251060553497ULL },
+	{ 16465723340661719040ULL, 10339757656912845935ULL },
+	{ 15970468157399760896ULL, 12924697071141057419ULL },
+	{ 15351399178322313216ULL, 16155871338926321774ULL },
+	{  4982938468024057856ULL, 10097419586828951109ULL },
+	{ 10840359103457460224ULL, 12621774483536188886ULL },
+	{  4327076842467049472ULL, 15777218104420236108ULL },
+	{ 11927795063396681728ULL,  9860761315262647567ULL },
+	{ 10298057810818464256ULL, 12325951644078309459ULL },
+	{  8260886245095692416ULL, 15407439555097886824ULL },
+	{  5163053903184807760ULL,  9629649721936179265ULL },
+	{ 11065503397408397604ULL, 12037062152420224081ULL },
+	{ 18443565265187884909ULL, 15046327690525280101ULL },
+	{ 13833071299956122020ULL,  9403954806578300063ULL },
+	{ 12679653106517764621ULL, 11754943508222875079ULL },
+	{ 11237880364719817872ULL, 14693679385278593849ULL },
+	{   212292400617608628ULL, 18367099231598242312ULL },
+	{   132682750386005392ULL, 11479437019748901445ULL },
+	{  4777539456409894645ULL, 14349296274686126806ULL },
+	{ 15195296357367144114ULL, 17936620343357658507ULL },
+	{  7191217214140771119ULL, 11210387714598536567ULL },
+	{  4377335499248575995ULL, 14012984643248170709ULL },
+	{ 10083355392488107898ULL, 17516230804060213386ULL },
+	{ 10913783138732455340ULL, 10947644252537633366ULL },
+	{  4418856886560793367ULL, 13684555315672041708ULL },
+	{  5523571108200991709ULL, 17105694144590052135ULL },
+	{ 10369760970266701674ULL, 10691058840368782584ULL },
+	{ 12962201212833377092ULL, 13363823550460978230ULL },
+	{  6979379479186945558ULL, 16704779438076222788ULL },
+	{ 13585484211346616781ULL, 10440487148797639242ULL },
+	{  7758483227328495169ULL, 13050608935997049053ULL },
+	{ 14309790052588006865ULL, 16313261169996311316ULL },
+	{ 18166990819722280098ULL, 10195788231247694572ULL },
+	{  4261994450943298507ULL, 12744735289059618216ULL },
+	{  5327493063679123134ULL, 15930919111324522770ULL },
+	{  7941369183226839863ULL,  9956824444577826731ULL },
+	{  5315025460606161924ULL, 12446030555722283414ULL },
+	{ 15867153862612478214ULL, 15557538194652854267ULL },
+	{  7611128154919104931ULL,  9723461371658033917ULL },
+	{ 14125596212076269068ULL, 12154326714572542396ULL },
+	{ 17656995265095336336ULL, 15192908393215677995ULL },
+	{  8729779031470891258ULL,  9495567745759798747ULL },
+	{  6300537770911226168ULL, 11869459682199748434ULL },
+	{ 17099044250493808518ULL, 14836824602749685542ULL },
+	{  6075216638131242420ULL,  9273015376718553464ULL },
+	{  7594020797664053025ULL, 11591269220898191830ULL },
+	{   269153960225290473ULL, 14489086526122739788ULL },
+	{   336442450281613091ULL, 18111358157653424735ULL },
+	{  7127805559067090038ULL, 11319598848533390459ULL },
+	{  4298070930406474644ULL, 14149498560666738074ULL },
+	{ 14595960699862869113ULL, 17686873200833422592ULL },
+	{  9122475437414293195ULL, 11054295750520889120ULL },
+	{ 11403094296767866494ULL, 13817869688151111400ULL },
+	{ 14253867870959833118ULL, 17272337110188889250ULL },
+	{ 13520353437777283602ULL, 10795210693868055781ULL },
+	{  3065383741939440791ULL, 13494013367335069727ULL },
+	{ 17666787732706464701ULL, 16867516709168837158ULL },
+	{  6430056314514152534ULL, 10542197943230523224ULL },
+	{  8037570393142690668ULL, 13177747429038154030ULL },
+	{   823590954573587527ULL, 16472184286297692538ULL },
+	{  5126430365035880108ULL, 10295115178936057836ULL },
+	{  6408037956294850135ULL, 12868893973670072295ULL },
+	{  3398361426941174765ULL, 16086117467087590369ULL },
+	{ 13653190937906703988ULL, 10053823416929743980ULL },
+	{ 17066488672383379985ULL, 12567279271162179975ULL },
+	{ 16721424822051837077ULL, 15709099088952724969ULL },
+	{  3533361486141316317ULL,  9818186930595453106ULL },
+	{ 13640073894531421205ULL, 12272733663244316382ULL },
+	{  7826720331309500698ULL, 15340917079055395478ULL },
+	{   280014188641050032ULL,  9588073174409622174ULL },
+	{  9573389772656088348ULL, 11985091468012027717ULL },
+	{ 16578423234247498339ULL, 14981364335015034646ULL },
+	{  5749828502977298558ULL,  9363352709384396654ULL },
+	{ 16410657665576399005ULL, 11704190886730495817ULL },
+	{  6678264026688335045ULL, 14630238608413119772ULL },
+	{  8347830033360418806ULL, 18287798260516399715ULL },
+	{  2911550761636567802ULL, 11429873912822749822ULL },
+	{ 12862810488900485560ULL, 14287342391028437277ULL },
+	{  2243455055843443238ULL, 17859177988785546597ULL },
+	{  3708002419115845976ULL, 11161986242990966623ULL },
+	{    23317005467419566ULL, 13952482803738708279ULL },
+	{ 13864204312116438170ULL, 17440603504673385348ULL },
+	{ 17888499731927549664ULL, 10900377190420865842ULL },
+	{ 13137252628054661272ULL, 13625471488026082303ULL },
+	{ 11809879766640938686ULL, 17031839360032602879ULL },
+	{ 14298703881791668535ULL, 10644899600020376799ULL },
+	{ 13261693833812197764ULL, 13306124500025470999ULL },
+	{ 11965431273837859301ULL, 16632655625031838749ULL },
+	{  9784237555362356015ULL, 10395409765644899218ULL },
+	{  3006924907348169211ULL, 12994262207056124023ULL },
+	{ 17593714189467375226ULL, 16242827758820155028ULL },
+	{  1772699331562333708ULL, 10151767349262596893ULL },
+	{  6827560182880305039ULL, 12689709186578246116ULL },
+	{  8534450228600381299ULL, 15862136483222807645ULL },
+	{  7639874402088932264ULL,  9913835302014254778ULL },
+	{   326470965756389522ULL, 12392294127517818473ULL },
+	{  5019774725622874806ULL, 15490367659397273091ULL },
+	{   831516194300602802ULL,  9681479787123295682ULL },
+	{ 10262767279730529310ULL, 12101849733904119602ULL },
+	{  3605087062808385830ULL, 15127312167380149503ULL },
+	{  9170708441896323000ULL,  9454570104612593439ULL },
+	{  6851699533943015846ULL, 11818212630765741799ULL },
+	{  3952938399001381903ULL, 14772765788457177249ULL },
+	{ 13999801545444333449ULL,  9232978617785735780ULL },
+	{ 17499751931805416812ULL, 11541223272232169725ULL },
+	{  8039631859474607303ULL, 14426529090290212157ULL },
+	{ 14661225842770647033ULL, 18033161362862765196ULL },
+	{ 18386638188586430203ULL, 11270725851789228247ULL },
+	{ 18371611717305649850ULL, 14088407314736535309ULL },
+	{  9129456591349898601ULL, 17610509143420669137ULL },
+	{ 17235125415662156385ULL, 11006568214637918210ULL },
+	{ 12320534732722919674ULL, 13758210268297397763ULL },
+	{ 10788982397476261688ULL, 17197762835371747204ULL },
+	{ 15966486035277439363ULL, 10748601772107342002ULL },
+	{ 10734735507242023396ULL, 13435752215134177503ULL },
+	{  8806733365625141341ULL, 16794690268917721879ULL },
+	{ 12421737381156795194ULL, 10496681418073576174ULL },
+	{  6303799689591218185ULL, 13120851772591970218ULL },
+	{ 17103121648843798539ULL, 16401064715739962772ULL },
+	{  1466078993672598279ULL, 10250665447337476733ULL },
+	{  6444284760518135752ULL, 12813331809171845916ULL },
+	{  8055355950647669691ULL, 16016664761464807395ULL },
+	{  2728754459941099604ULL, 10010415475915504622ULL },
+	{ 12634315111781150314ULL, 12513019344894380777ULL },
+	{  1957835834444274180ULL, 15641274181117975972ULL },
+	{ 10447019433382447170ULL,  9775796363198734982ULL },
+	{  3835402254873283155ULL, 12219745453998418728ULL },
+	{  4794252818591603944ULL, 15274681817498023410ULL },
+	{  7608094030047140369ULL,  9546676135936264631ULL },
+	{  4898431519131537557ULL, 11933345169920330789ULL },
+	{ 10734725417341809851ULL, 14916681462400413486ULL },
+	{  2097517367411243253ULL,  9322925914000258429ULL },
+	{  7233582727691441970ULL, 11653657392500323036ULL },
+	{  9041978409614302462ULL, 14567071740625403795ULL },
+	{  6690786993590490174ULL, 18208839675781754744ULL },
+	{  4181741870994056359ULL, 11380524797363596715ULL },
+	{   615491320315182544ULL, 14225655996704495894ULL },
+	{  9992736187248753989ULL, 17782069995880619867ULL },
+	{  3939617107816777291ULL, 11113793747425387417ULL },
+	{  9536207403198359517ULL, 13892242184281734271ULL },
+	{  7308573235570561493ULL, 17365302730352167839ULL },
+	{ 11485387299872682789ULL, 10853314206470104899ULL },
+	{  9745048106413465582ULL, 13566642758087631124ULL },
+	{ 12181310133016831978ULL, 16958303447609538905ULL },
+	{   695789805494438130ULL, 10598939654755961816ULL },
+	{   869737256868047663ULL, 13248674568444952270ULL },
+	{ 10310543607939835386ULL, 16560843210556190337ULL },
+	{ 17973304801030866876ULL, 10350527006597618960ULL },
+	{  4019886927579031980ULL, 12938158758247023701ULL },
+	{  9636544677901177879ULL, 16172698447808779626ULL },
+	{ 10634526442115624078ULL, 10107936529880487266ULL },
+	{  4069786015789754290ULL, 12634920662350609083ULL },
+	{   475546501309804958ULL, 15793650827938261354ULL },
+	{  4908902581746016003ULL,  9871031767461413346ULL },
+	{ 15359500264037295811ULL, 12338789709326766682ULL },
+	{  9976003293191843956ULL, 15423487136658458353ULL },
+	{ 17764217104313372233ULL,  9639679460411536470ULL },
+	{ 12981899343536939483ULL, 12049599325514420588ULL },
+	{ 16227374179421174354ULL, 15061999156893025735ULL },
+	{ 17059637889779315827ULL,  9413749473058141084ULL },
+	{  2877803288514593168ULL, 11767186841322676356ULL },
+	{  3597254110643241460ULL, 14708983551653345445ULL },
+	{  9108253656731439729ULL, 18386229439566681806ULL },
+	{  1080972517029761926ULL, 11491393399729176129ULL },
+	{  5962901664714590312ULL, 14364241749661470161ULL },
+	{ 12065313099320625794ULL, 17955302187076837701ULL },
+	{  9846663696289085073ULL, 11222063866923023563ULL },
+	{  7696643601933968437ULL, 14027579833653779454ULL },
+	{   397432465562684739ULL, 17534474792067224318ULL },
+	{ 14083453346258841674ULL, 10959046745042015198ULL },
+	{  8380944645968776284ULL, 13698808431302518998ULL },
+	{  1252808770606194547ULL, 17123510539128148748ULL },
+	{ 10006377518483647400ULL, 10702194086955092967ULL },
+	{  7896285879677171346ULL, 13377742608693866209ULL },
+	{ 14482043368023852087ULL, 16722178260867332761ULL },
+	{  2133748077373825698ULL, 10451361413042082976ULL },
+	{  2667185096717282123ULL, 13064201766302603720ULL },
+	{  3333981370896602653ULL, 16330252207878254650ULL },
+	{  6695424375237764562ULL, 10206407629923909156ULL },
+	{  8369280469047205703ULL, 12758009537404886445ULL },
+	{ 15073286604736395033ULL, 15947511921756108056ULL },
+	{  9420804127960246895ULL,  9967194951097567535ULL },
+	{  7164319141522920715ULL, 12458993688871959419ULL },
+	{  4343712908476262990ULL, 15573742111089949274ULL },
+	{  7326506586225052273ULL,  9733588819431218296ULL },
+	{  9158133232781315341ULL, 12166986024289022870ULL },
+	{  2224294504121868368ULL, 15208732530361278588ULL },
+	{ 10613556101930943538ULL,  9505457831475799117ULL },
+	{ 17878631145841067327ULL, 11881822289344748896ULL },
+	{  3901544858591782542ULL, 14852277861680936121ULL },
+	{ 13967680582688333849ULL,  9282673663550585075ULL },
+	{ 12847914709933029407ULL, 11603342079438231344ULL },
+	{ 16059893387416286759ULL, 14504177599297789180ULL },
+	{  1628122660560806833ULL, 18130221999122236476ULL },
+	{ 10240948699705280078ULL, 11331388749451397797ULL },
+	{ 17412871893058988002ULL, 14164235936814247246ULL },
+	{ 12542717829468959195ULL, 17705294921017809058ULL },
+	{ 12450884661845487401ULL, 11065809325636130661ULL },
+	{  1728547772024695539ULL, 13832261657045163327ULL },
+	{ 15995742770313033136ULL, 17290327071306454158ULL },
+	{  5385653213018257806ULL, 10806454419566533849ULL },
+	{ 11343752534700210161ULL, 13508068024458167311ULL },
+	{  9568004649947874797ULL, 16885085030572709139ULL },
+	{  3674159897003727796ULL, 10553178144107943212ULL },
+	{  4592699871254659745ULL, 13191472680134929015ULL },
+	{  1129188820640936778ULL, 16489340850168661269ULL },
+	{  3011586022114279438ULL, 10305838031355413293ULL },
+	{  8376168546070237202ULL, 12882297539194266616ULL },
+	{ 10470210682587796502ULL, 16102871923992833270ULL },
+	{  1932195658189984910ULL, 10064294952495520794ULL },
+	{ 11638616609592256945ULL, 12580368690619400992ULL },
+	{ 14548270761990321182ULL, 15725460863274251240ULL },
+	{  9092669226243950738ULL,  9828413039546407025ULL },
+	{ 15977522551232326327ULL, 12285516299433008781ULL },
+	{  6136845133758244197ULL, 15356895374291260977ULL },
+	{ 15364743254667372383ULL,  9598059608932038110ULL },
+	{  9982557031479439671ULL, 11997574511165047638ULL },
+	{  3254824252494523781ULL, 14996968138956309548ULL },
+	{ 11257637194663853171ULL,  9373105086847693467ULL },
+	{  9460360474902428559ULL, 11716381358559616834ULL },
+	{  2602078556773259891ULL, 14645476698199521043ULL },
+	{ 17087656251248738576ULL, 18306845872749401303ULL },
+	{ 17597314184671543466ULL, 11441778670468375814ULL },
+	{ 12773270693984653525ULL, 14302223338085469768ULL },
+	{ 15966588367480816906ULL, 17877779172606837210ULL },
+	{ 14590803748102898470ULL, 11173611982879273256ULL },
+	{ 18238504685128623088ULL, 13967014978599091570ULL },
+	{ 13574758819556003052ULL, 17458768723248864463ULL },
+	{ 15401753289863583763ULL, 10911730452030540289ULL },
+	{  5417133557047315992ULL, 13639663065038175362ULL },
+	{ 15994788983163920798ULL, 17049578831297719202ULL },
+	{ 14608429132904838403ULL, 10655986769561074501ULL },
+	{  4425478360848884291ULL, 13319983461951343127ULL },
+	{   920161932633717460ULL, 16649979327439178909ULL },
+	{  2880944217109767365ULL, 10406237079649486818ULL },
+	{ 12824552308241985014ULL, 13007796349561858522ULL },
+	{  6807318348447705459ULL, 16259745436952323153ULL },
+	{ 15783789013848285672ULL, 10162340898095201970ULL },
+	{ 10506364230455581282ULL, 12702926122619002463ULL },
+	{  8521269269642088699ULL, 15878657653273753079ULL },
+	{ 12243322321167387293ULL,  9924161033296095674ULL },
+	{  6080780864604458308ULL, 12405201291620119593ULL },
+	{ 12212662099182960789ULL, 15506501614525149491ULL },
+	{  5327070802775656541ULL,  9691563509078218432ULL },
+	{  6658838503469570676ULL, 12114454386347773040ULL },
+	{  8323548129336963345ULL, 15143067982934716300ULL },
+	{ 14425589617690377899ULL,  9464417489334197687ULL },
+	{ 13420301003685584469ULL, 11830521861667747109ULL },
+	{  2940318199324816875ULL, 14788152327084683887ULL },
+	{  8755227902219092403ULL,  9242595204427927429ULL },
+	{ 15555720896201253407ULL, 11553244005534909286ULL },
+	{ 10221279083396790951ULL, 14441555006918636608ULL },
+	{ 12776598854245988689ULL, 18051943758648295760ULL },
+	{  7985374283903742931ULL, 11282464849155184850ULL },
+	{   758345818024902856ULL, 14103081061443981063ULL },
+	{ 14782990327813292282ULL, 17628851326804976328ULL },
+	{  9239368954883307676ULL, 11018032079253110205ULL },
+	{ 16160897212031522499ULL, 13772540099066387756ULL },
+	{  1754377441329851508ULL, 17215675123832984696ULL },
+	{  1096485900831157192ULL, 10759796952395615435ULL },
+	{ 15205665431321110202ULL, 13449746190494519293ULL },
+	{  5172023733869224041ULL, 16812182738118149117ULL },
+	{  5538357842881958977ULL, 10507614211323843198ULL },
+	{ 16146319340457224530ULL, 13134517764154803997ULL },
+	{  6347841120289366950ULL, 16418147205193504997ULL },
+	{  6273243709394548296ULL, 10261342003245940623ULL },
+};
+
+#endif /* _POW5_H */
@@ -0,0 +1,162 @@
+#ifndef _SCAN_H
+#define _SCAN_H
+
+// Block scanning of wide character buffers.
+// SSE2 is the baseline on x86/x64, AVX2 is picked at runtime when both the
+// CPU and the OS support it, everything else falls back to a scalar loop.
+
+#include <stddef.h>
+#include <wchar.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SCAN_AVX2_TARGET
+#else
+#include <cpuid.h>
+#define SCAN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace Scan {
+
+#ifdef SCAN_SSE2
+#if WCHAR_MAX > 0xFFFF
+	#define SCAN_SET1_128(c)       _mm_set1_epi32((int)(c))
+	#define SCAN_CMPEQ_128(a, b)   _mm_cmpeq_epi32(a, b)
+	#define SCAN_SET1_256(c)       _mm256_set1_epi32((int)(c))
+	#define SCAN_CMPEQ_256(a, b)   _mm256_cmpeq_epi32(a, b)
+	#define SCAN_CHARSHIFT 2
+#else
+	#define SCAN_SET1_128(c)       _mm_set1_epi16((short)(c))
+	#define SCAN_CMPEQ_128(a, b)   _mm_cmpeq_epi16(a, b)
+	#define SCAN_SET1_256(c)       _mm256_set1_epi16((short)(c))
+	#define SCAN_CMPEQ_256(a, b)   _mm256_cmpeq_epi16(a, b)
+	#define SCAN_CHARSHIFT 1
+#endif
+
+	inline unsigned int LowestBit( unsigned int mask )
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (unsigned int)index;
+#else
+		return (unsigned int)__builtin_ctz(mask);
+#endif
+	}
+
+	inline bool HasAVX2()
+	{
+		static int avx2 = -1;
+		if (avx2 < 0) {
+			int ret = 0;
+#ifdef _MSC_VER
+			int regs[4];
+			__cpuid(regs, 0);
+			if (regs[0] >= 7) {
+				__cpuid(regs, 1);
+				// OSXSAVE and AVX, then check that the OS saves YMM state
+				if (((regs[2] & (1 << 27)) != 0) && ((regs[2] & (1 << 28)) != 0) &&
+					((_xgetbv(0) & 6) == 6)) {
+					__cpuidex(regs, 7, 0);
+					ret = (regs[1] & (1 << 5)) != 0;
+				}
+			}
+#else
+			unsigned int a, b, c, d;
+			if (__get_cpuid_max(0, NULL) >= 7) {
+				__cpuid(1, a, b, c, d);
+				if (((c & (1 << 27)) != 0) && ((c & (1 << 28)) != 0)) {
+					unsigned int xlo, xhi;
+					__asm__ ("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+					if ((xlo & 6) == 6) {
+						__cpuid_count(7, 0, a, b, c, d);
+						ret = (b & (1 << 5)) != 0;
+					}
+				}
+			}
+#endif
+			avx2 = ret;
+		}
+		return avx2 != 0;
+	}
+
+	SCAN_AVX2_TARGET
+	inline const wchar_t *FindAnyAVX2( const wchar_t *ptr, const wchar_t *end, wchar_t a, wchar_t b, wchar_t c, wchar_t d )
+	{
+		const size_t block = 32 / sizeof(wchar_t);
+		const __m256i va = SCAN_SET1_256(a);
+		const __m256i vb = SCAN_SET1_256(b);
+		const __m256i vc = SCAN_SET1_256(c);
+		const __m256i vd = SCAN_SET1_256(d);
+		while ((size_t)(end - ptr) >= block) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)ptr);
+			__m256i eq = _mm256_or_si256(_mm256_or_si256(SCAN_CMPEQ_256(v, va), SCAN_CMPEQ_256(v, vb)),
+										 _mm256_or_si256(SCAN_CMPEQ_256(v, vc), SCAN_CMPEQ_256(v, vd)));
+			unsigned int mask = (unsigned int)_mm256_movemask_epi8(eq);
+			if (mask != 0)
+				return ptr + (LowestBit(mask) >> SCAN_CHARSHIFT);
+			ptr += block;
+		}
+		return ptr;
+	}
+
+	inline const wchar_t *FindAnySSE2( const wchar_t *ptr, const wchar_t *end, wchar_t a, wchar_t b, wchar_t c, wchar_t d )
+	{
+		const size_t block = 16 / sizeof(wchar_t);
+		const __m128i va = SCAN_SET1_128(a);
+		const __m128i vb = SCAN_SET1_128(b);
+		const __m128i vc = SCAN_SET1_128(c);
+		const __m128i vd = SCAN_SET1_128(d);
+		while ((size_t)(end - ptr) >= block) {
+			__m128i v = _mm_loadu_si128((const __m128i *)ptr);
+			__m128i eq = _mm_or_si128(_mm_or_si128(SCAN_CMPEQ_128(v, va), SCAN_CMPEQ_128(v, vb)),
+									  _mm_or_si128(SCAN_CMPEQ_128(v, vc), SCAN_CMPEQ_128(v, vd)));
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+			if (mask != 0)
+				return ptr + (LowestBit(mask) >> SCAN_CHARSHIFT);
+			ptr += block;
+		}
+		return ptr;
+	}
+#endif /* SCAN_SSE2 */
+
+	// Returns the first character in [ptr, end) equal to any of a, b, c or d,
+	// or end if there is none. Repeat a needle to look for less characters.
+	inline const wchar_t *FindAny( const wchar_t *ptr, const wchar_t *end, wchar_t a, wchar_t b, wchar_t c, wchar_t d )
+	{
+#ifdef SCAN_SSE2
+		if (HasAVX2())
+			ptr = FindAnyAVX2(ptr, end, a, b, c, d);
+		ptr = FindAnySSE2(ptr, end, a, b, c, d);
+#endif
+		for(; ptr < end; ptr++) {
+			wchar_t ch = *ptr;
+			if ((ch == a) || (ch == b) || (ch == c) || (ch == d))
+				break;
+		}
+		return ptr;
+	}
+
+	inline const wchar_t *FindAny( const wchar_t *ptr, const wchar_t *end, wchar_t a, wchar_t b, wchar_t c )
+	{
+		return FindAny(ptr, end, a, b, c, c);
+	}
+
+	inline const wchar_t *FindAny( const wchar_t *ptr, const wchar_t *end, wchar_t a, wchar_t b )
+	{
+		return FindAny(ptr, end, a, b, b, b);
+	}
+
+	inline const wchar_t *Find( const wchar_t *ptr, const wchar_t *end, wchar_t a )
+	{
+		return FindAny(ptr, end, a, a, a, a);
+	}
+
+} /* Scan */
+
+#endif /* _SCAN_H */
@@ -1,16 +1,36 @@
 #ifndef _UTILS_H
 #define _UTILS_H
 
+#include <string>
+#include <unordered_set>
+
+namespace aria { namespace csv { class FileSource; } }
+
 namespace Utils {
 
-	const LPCWSTR CSVfilter = L"CSV \0*.csv;*.txt\0 \0*\0";
-	const LPCWSTR TXTfilter = L"TXT \0*.txt\0 \0*\0";
-	const LPCWSTR CSVext = L"csv";
-	const LPCWSTR TXText = L"txt";
+	// what ParsePath tells about a path, all at once
+	enum {
+		PP_NONE		= 0x00,
+		PP_PATH		= 0x01,
+		PP_FILENS	= 0x02,
+		PP_DEVNS	= 0x04,
+		PP_UNCPR	= 0x08,
+		PP_UNC		= 0x10,
+		PP_DRIVE	= 0x20,
+		PP_VOLUME	= 0x40,
+		PP_PIPE		= 0x80,
+		PP_SLASH	= 0x100
+	};
 
+	typedef struct {
+		SIZE_T root;	// length of the part '..' can't climb over: drive, server and share or locked reference
+		SIZE_T tokens;	// components after root
+	} PATHINFO;
+
+	// utilscore.cpp, platform independent
 	void SanitizeString( LPWSTR str, LPCWSTR notallow, WCHAR replace );
 	BOOL IsValidGUID( LPCWSTR guidStr, BOOL embraced = TRUE );
-	INT ParsePath( LPCWSTR path, SIZE_T len, LPWSTR * endptr = NULL );
+	INT ParsePath( LPCWSTR path, SIZE_T len = (SIZE_T)-1, LPWSTR * endptr = NULL ); // PP_ bits or -1, stops at len or NUL
 	BOOL IsPathRelative( INT ppath );
 	BOOL IsPathRelative( LPCWSTR path );
 	BOOL IsPathNetwork( INT ppath );
@@ -20,24 +40,48 @@ namespace Utils {
 	BOOL IsPathPipe( INT ppath );
 	BOOL IsPathPipe( LPCWSTR path );
 	BOOL SanitizeFileSystemString( LPWSTR str, SIZE_T strlen, WCHAR replacement, BOOL filename = FALSE, BOOL notrailsep = FALSE, LPWSTR * rootptr = NULL );
-	BOOL SanitizeFileSystemString( CString & str, WCHAR replacement, BOOL filename = FALSE, BOOL notrailsep = FALSE, LPWSTR * rootptr = NULL );
-	LPWSTR AbsPath( LPCWSTR path, LPCWSTR reference, BOOL reflock = FALSE, WCHAR sareplacement = '_' );
-	BOOL CreateDirectoryRecursively( const CString directory );
-	DWORD GetModulePathName( LPWSTR pathname, SIZE_T pnsz, SIZE_T *nameidx = NULL );
-	BOOL Str2Clipboard(LPCWSTR str);
+	SIZE_T CanonicalPath( LPCWSTR path, LPCWSTR reference, LPWSTR buf, SIZE_T bufsz, PATHINFO * info = NULL, BOOL reflock = FALSE, WCHAR replacement = '_' );
 
-	BOOL ParseDouble( LPCWSTR str, LPCWSTR & endptr, DOUBLE & val, _locale_t locale = NULL );
+	BOOL ParseDouble( LPCWSTR str, LPCWSTR & endptr, DOUBLE & val );
 	double RadtoDeg(double Rad);
 	double DegtoRad(double Deg);
 
-	UINT GetFileName( BOOL save, LPCWSTR defpathname, LPCWSTR title, LPCWSTR suffix, LPCWSTR filter, LPCWSTR defext, OPENFILENAME* & filename );
-	void FreeFileName(OPENFILENAME* & filename);
-	UINT OpenCSVFile( std::wifstream & file, LPWSTR pathname );
-
 	INT Matches( LPCWSTR cmd, LPCWSTR pattern );
 	UINT UnSlash( LPWSTR s ); 	// from Notepad2
 
+	// utils.cpp on Windows, posix/utils_posix.cpp elsewhere
+	DWORD GetModulePathName( LPWSTR pathname, SIZE_T pnsz, SIZE_T *nameidx = NULL );
+
+#ifdef _WIN32
+	// utils.cpp, Win32 and MFC
+	const LPCWSTR CSVfilter = L"CSV \0*.csv;*.txt\0 \0*\0";
+	const LPCWSTR TXTfilter = L"TXT \0*.txt\0 \0*\0";
+	const LPCWSTR CSVext = L"csv";
+	const LPCWSTR TXText = L"txt";
+
+	BOOL SanitizeFileSystemString( CString & str, WCHAR replacement, BOOL filename = FALSE, BOOL notrailsep = FALSE, LPWSTR * rootptr = NULL );
+	BOOL CreateDirectoryRecursively( const CString directory );
+
+	// directories already checked or created, so files going to the same few
+	// directories of a batch don't ask the file system about them again
+	class DirectoryCache {
+	public:
+		BOOL Create( const CString & directory ); // same as CreateDirectoryRecursively, forgets everything on failure
+		void Clear() { m_known.clear(); };
+	private:
+		std::unordered_set<std::wstring> m_known; // lower case, separated by '\\', without trailing separator
+	};
+
+	BOOL Str2Clipboard(LPCWSTR str);
+	void AppendDouble( CString & str, DOUBLE val );
+
+	UINT GetFileName( BOOL save, LPCWSTR defpathname, LPCWSTR title, LPCWSTR suffix, LPCWSTR filter, LPCWSTR defext, OPENFILENAME* & filename );
+	void FreeFileName(OPENFILENAME* & filename);
+	UINT OpenCSVFile( aria::csv::FileSource & file, LPCWSTR pathname );
+	void CSVDialectString( CString & str, const aria::csv::FileSource & file, WCHAR delimiter );
+
 	BOOL ComStrStatus( CString & str, UINT status, BOOL append );
+#endif
 } /* Utils */
 
 #endif /* _UTILS_H */
@@ -0,0 +1,643 @@
+#include "stdafx.h"
+
+// Platform independent part of Utils: string, path and number handling with
+// nothing but the CRT below it. Builds with the projects' stdafx.h on Windows
+// and with posix/stdafx.h elsewhere, see there
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "utils.h"
+#include "numeric.h"
+#include "scan.h"
+
+void Utils::SanitizeString( LPWSTR str, LPCWSTR notallow, WCHAR replace )
+{
+	LPWSTR pstr = str;
+	while((pstr = wcspbrk(pstr, notallow)) != NULL) {
+		*pstr = replace;
+		pstr++;
+	}
+}
+
+BOOL Utils::IsValidGUID( LPCWSTR guidStr, BOOL embraced )
+{
+	if (embraced && (*guidStr++ != '{'))
+		return FALSE;
+
+	const WCHAR GLT[] = L"00000000-0000-0000-0000-000000000000";
+	for(SIZE_T pos = 0; pos < _countof(GLT) - 1; pos++) {
+		WCHAR ch = *guidStr++;
+		if (GLT[pos] == L'0') {
+			if (!iswxdigit(ch))
+				return FALSE;
+		} else if (GLT[pos] != ch)
+			return FALSE;
+	}
+	if (embraced && (*guidStr++ != '}'))
+		return FALSE;
+	return TRUE;
+}
+
+// Prefixes ParsePath knows and what may follow each. A ppart one may as well
+// start a relative path, it is skipped unclassified then
+typedef struct {
+	UINT len;
+	UINT type;
+	UINT next;
+	BOOL ppart;
+} pathseq_t;
+
+enum { PS_FILENS, PS_DEVNS, PS_UNCPR, PS_UNC, PS_DRIVE, PS_VOLUME, PS_PIPE, PS_NONE };
+
+static const pathseq_t s_pathseqs[] = {
+	{ 4,  Utils::PP_FILENS, Utils::PP_DRIVE|Utils::PP_VOLUME|Utils::PP_UNC, FALSE },	// "\\?\"
+	{ 4,  Utils::PP_DEVNS, Utils::PP_DRIVE|Utils::PP_PIPE|Utils::PP_PATH, FALSE },	// "\\.\", PP_PATH for device path
+	{ 2,  Utils::PP_UNCPR, Utils::PP_PATH, TRUE },									// "\\"
+	{ 4,  Utils::PP_UNC, Utils::PP_PATH, TRUE },									// "UNC\"
+	{ 2,  Utils::PP_DRIVE, Utils::PP_PATH, FALSE },									// "x:"
+	{ 45, Utils::PP_VOLUME, Utils::PP_PATH, TRUE },									// "Volume{00000000-0000-0000-0000-000000000000}\"
+	{ 5,  Utils::PP_PIPE, Utils::PP_PATH, TRUE }									// "pipe\"
+};
+
+// the prefix path starts with, told by its first character; -1 for a broken volume name
+static INT PathSeqAt( LPCWSTR path, SIZE_T maxlen )
+{
+	switch (path[0]) {
+	case '\\':
+		if ((maxlen < 2) || (path[1] != '\\'))
+			break;
+		if ((maxlen >= 4) && (path[2] == '?') && (path[3] == '\\'))
+			return PS_FILENS;
+		if ((maxlen >= 4) && (path[2] == '.') && (path[3] == '\\'))
+			return PS_DEVNS;
+		return PS_UNCPR;
+	case 'U': case 'u':
+		if ((maxlen >= 4) && ((path[1] | 0x20) == 'n') && ((path[2] | 0x20) == 'c') && (path[3] == '\\'))
+			return PS_UNC;
+		break;
+	case 'V': case 'v':
+		if ((maxlen >= 45) && (_wcsnicmp(path, L"Volume", 6) == 0) && (wcsnlen(path, 45) == 45)) {
+			if (!Utils::IsValidGUID(path + 6, TRUE) ||
+				(path[44] != '\\')) // MSFT: All volume and mounted folder functions that take a volume GUID path as an input parameter require the trailing backslash
+				return -1;
+			return PS_VOLUME;
+		}
+		break;
+	case 'P': case 'p':
+		if ((maxlen >= 5) && ((path[1] | 0x20) == 'i') && ((path[2] | 0x20) == 'p') && ((path[3] | 0x20) == 'e') && (path[4] == '\\'))
+			return PS_PIPE;
+		break;
+	}
+	if ((maxlen >= 2) && (path[1] == ':') && iswalpha(path[0]))
+		return PS_DRIVE;
+	return PS_NONE;
+}
+
+// one pass over the prefixes, the state is the set of those allowed next
+INT Utils::ParsePath( LPCWSTR path, SIZE_T maxlen, LPWSTR * endptr )
+{
+	INT next = PP_PATH | PP_FILENS | PP_DEVNS | PP_UNCPR | PP_DRIVE;
+	INT ppath = PP_NONE;
+	LPCWSTR savepath = NULL;
+	while(maxlen && *path) {
+		INT seq = PathSeqAt(path, maxlen);
+		if (seq < 0)
+			return -1;
+		if (seq == PS_NONE) {
+			if ((next & PP_PATH) == 0)
+				return -1;
+			if (savepath != NULL) path = savepath;
+			if ((ppath & PP_DRIVE) && (*path == '\\')) { // consume only one separator, leaving others to normalizer
+				ppath |= PP_SLASH;
+				path++;
+			}
+			break;
+		}
+		const pathseq_t & i = s_pathseqs[seq];
+		if ((i.type & next) == 0) {
+			if (((next & PP_PATH) == 0) || !i.ppart)
+				return -1;
+			savepath = path;
+		} else
+			ppath |= i.type;
+		next = i.next;
+		path += i.len;
+		maxlen -= i.len;
+	}
+	if (endptr != NULL)
+		*endptr = (LPWSTR)path;
+
+	return ppath;
+}
+
+BOOL Utils::IsPathRelative( INT ppath )
+{
+	switch (ppath) {
+	case PP_NONE:
+	case PP_SLASH:
+		return TRUE;
+	}
+	return FALSE;
+}
+
+BOOL Utils::IsPathRelative( LPCWSTR path )
+{
+	INT ppath = ParsePath( path );
+	if (ppath < 0)
+		return TRUE;
+	return IsPathRelative( ppath );
+}
+
+BOOL Utils::IsPathNetwork( INT ppath )
+{
+	switch (ppath) {
+	case PP_UNCPR:
+	case PP_FILENS|PP_UNC:
+		return TRUE;
+	}
+	return FALSE;
+}
+
+BOOL Utils::IsPathNetwork( LPCWSTR path )
+{
+	INT ppath = ParsePath( path );
+	if (ppath < 0)
+		return FALSE;
+	return IsPathNetwork( ppath );
+}
+
+BOOL Utils::IsPathDevice( INT ppath )
+{
+	switch (ppath) {
+	case PP_DEVNS:
+		return TRUE;
+	}
+	return FALSE;
+}
+
+BOOL Utils::IsPathDevice( LPCWSTR path )
+{
+	INT ppath = ParsePath( path );
+	if (ppath < 0)
+		return FALSE;
+	return IsPathDevice( ppath );
+}
+
+BOOL Utils::IsPathPipe( INT ppath )
+{
+	switch (ppath) {
+	case PP_DEVNS|PP_PIPE:
+		return TRUE;
+	}
+	return FALSE;
+}
+
+BOOL Utils::IsPathPipe( LPCWSTR path )
+{
+	INT ppath = ParsePath( path );
+	if (ppath < 0)
+		return FALSE;
+	return IsPathPipe( ppath );
+}
+
+BOOL Utils::SanitizeFileSystemString( LPWSTR str, SIZE_T strlen, WCHAR replacement, BOOL asfilename, BOOL notrailsep, LPWSTR *rootptr )
+{
+	LPWSTR in = str;
+	INT ppath = PP_NONE;
+	if (strlen == 0)
+		strlen = wcslen(str);
+	BOOL isnet = FALSE;
+	BOOL isdev = FALSE;
+	LPWSTR root = str;
+
+	if (!asfilename) {
+		ppath = ParsePath(str, strlen, &in);
+		isnet = IsPathNetwork(ppath);
+		isdev = IsPathDevice(ppath);						// burden logic
+		if ((ppath < 0) ||									// invalid path
+			((ppath & (PP_DRIVE|PP_SLASH)) == PP_DRIVE) ||	// don't support silly paths relative to current directory of the drive
+			((ppath & (PP_VOLUME|PP_PIPE)) != 0) ||			// volume and pipe specifications are not supported
+			isdev)											// only drive names in the device namespace are supported
+			return FALSE;
+		strlen -= (in - str);
+		root = in;
+	}
+
+	INT tokens = 0;
+	INT tokpos = 0;
+	LPWSTR out = in;
+	WCHAR ch;
+	while(strlen && (ch = *in)) {
+		if (ch < 32)
+			ch = replacement;
+		else {
+			if ((tokpos == 0) && (ch == L' ')) {		// trim leading spaces
+				in++;
+				continue;
+			}
+			LPCWSTR forbidden;
+			if (isnet && (tokens == 0)) {
+				if ((tokpos == 0) && (ch == '.'))		// MSFT: (NetBIOS computer) Names can contain a period, but names cannot start with a period.
+					return FALSE;
+				forbidden = L"<>:\"\\/|?*";				// computer name
+			} else
+				forbidden = L"<>:\"\\/|?*";				// device/share/path
+			if (wcschr(forbidden, ch)) {
+				if (!asfilename && (ch == '\\')) {
+					if ((in > str) && *(in - 1) == '\\') { // normalize separators
+						in++;
+					    continue;
+					}
+					while(out > root) {					// trim token trailing spaces and periods, preserving special . and .. tokens
+						switch(*(out - 1)) {			
+						case L'.':
+							if ((tokpos == 1) ||
+								((tokpos == 2) && (*(out - 2) == L'.')))
+								break;
+							out--;
+							continue;
+						case L' ':
+							out--; tokpos--;
+							continue;
+						case L'\\':						// eliminate resuling empty token
+							out--; tokens--;
+							break;
+						}
+						break;
+					}
+					tokens++; tokpos = -1;
+					if ((isdev && (tokens == 1)) ||		// device path
+						(isnet && (tokens == 2)))		// or network path
+						root = out + 1;					// update root
+				} else {
+					if (isnet && (tokens == 0))
+						return FALSE;					// bad computer name
+					ch = replacement;
+				}
+			}
+		}
+		*out++ = ch;
+		in++;
+		strlen--;
+		tokpos++;
+	}
+	while(out > root) {									// trim trailing separators, spaces and periods
+		switch(*(out - 1)) {
+		case L'.':
+			if ((tokpos == 1) ||
+				((tokpos == 2) && (*(out - 2) == L'.')))
+				break;
+			out--;
+			continue;
+		case L' ':
+			out--; tokpos--;
+			continue;
+		case L'\\':
+			if (notrailsep ||							// trim trailing separator if requested
+				((out - root) == 1) ||					// or final path is empty
+				(*(in - 1) != '\\'))					// or initial path doesn't end with a trailing separator
+				out--;
+			tokens--;
+			break;
+		}
+		break;
+	}
+	*out = '\0';
+
+	if (rootptr)
+		*rootptr = root;
+
+	return TRUE;
+}
+
+typedef struct {
+	LPWSTR out;
+	LPWSTR root;		// '..' doesn't climb over it
+	SIZE_T tokens;		// components after root
+	WCHAR replacement;
+} canon_t;
+
+// trims trailing spaces and periods of the token the way SanitizeFileSystemString does, preserving . and ..
+static void CanonTrim( canon_t & c, LPWSTR tokstart, INT & tokpos )
+{
+	while(c.out > tokstart) {
+		switch(*(c.out - 1)) {
+		case L'.':
+			if ((tokpos == 1) ||
+				((tokpos == 2) && (c.out - 2 >= tokstart) && (*(c.out - 2) == L'.')))
+				break;
+			c.out--;
+			continue;
+		case L' ':
+			c.out--; tokpos--;
+			continue;
+		}
+		break;
+	}
+}
+
+// finished token: . is dropped, .. takes the previous component away, anything else is kept
+// returns TRUE if the token was kept
+static BOOL CanonCommit( canon_t & c, LPWSTR tokstart, BOOL collapse, BOOL sep )
+{
+	SIZE_T toklen = c.out - tokstart;
+	if (collapse && (*tokstart == L'.') && ((toklen == 1) || ((toklen == 2) && (tokstart[1] == L'.')))) {
+		c.out = tokstart;
+		if ((toklen == 2) && (c.out > c.root)) { // parent dir
+			c.out--;
+			while((c.out > c.root) && (*(c.out - 1) != L'\\'))
+				c.out--;
+			if (c.tokens > 0)
+				c.tokens--;
+		}
+		return FALSE;
+	}
+	if (sep)
+		*c.out++ = L'\\';
+	c.tokens++;
+	return TRUE;
+}
+
+// collapses the text after root at once, for when it could not be done token by token
+static void CanonCollapse( canon_t & c )
+{
+	LPWSTR end = c.out;
+	LPWSTR in = c.root;
+	c.out = c.root;
+	c.tokens = 0;
+	while(in < end) {
+		LPWSTR tok = in;
+		while((in < end) && (*in != L'\\'))
+			in++;
+		SIZE_T toklen = in - tok;
+		BOOL sep = (in < end);
+		if (sep)
+			in++;
+		if (toklen == 0)
+			continue;
+		LPWSTR tokstart = c.out;
+		wmemmove(c.out, tok, toklen);
+		c.out += toklen;
+		CanonCommit(c, tokstart, TRUE, sep);
+	}
+}
+
+// sanitizes one segment of the path like SanitizeFileSystemString does, collapsing each token as it ends
+// ownroot: the segment is absolute, its root limits '..'; collapse: FALSE keeps the sanitized text as it is
+// last: nothing follows, no trailing separator
+// ppath and in are what ParsePath gives for str
+static BOOL CanonSegment( canon_t & c, LPCWSTR str, INT ppath, LPCWSTR in, BOOL ownroot, BOOL collapse, BOOL last )
+{
+	BOOL isnet = Utils::IsPathNetwork(ppath);
+	if ((ppath < 0) ||									// invalid path
+		((ppath & (Utils::PP_DRIVE|Utils::PP_SLASH)) == Utils::PP_DRIVE) ||	// don't support silly paths relative to current directory of the drive
+		((ppath & (Utils::PP_VOLUME|Utils::PP_PIPE)) != 0) ||			// volume and pipe specifications are not supported
+		Utils::IsPathDevice(ppath))						// only drive names in the device namespace are supported
+		return FALSE;
+	if (ownroot) {
+		for(LPCWSTR prefix = str; prefix < in; prefix++)
+			*c.out++ = *prefix;
+		c.root = c.out;
+		c.tokens = 0;
+	} else {
+		// whatever ParsePath took for a prefix of a relative path is not sanitized, but still collapsed
+		for(LPCWSTR prefix = str; prefix < in; ) {
+			LPWSTR tokstart = c.out;
+			while((prefix < in) && (*prefix != '\\'))
+				*c.out++ = *prefix++;
+			BOOL sep = (prefix < in);
+			if (sep)
+				prefix++;
+			if (c.out != tokstart)
+				CanonCommit(c, tokstart, collapse, sep);
+		}
+	}
+
+	LPWSTR tokstart = c.out;
+	BOOL literal = !collapse || (isnet && ownroot);	// network root is known only after the share name, keep the text till then
+	BOOL atroot = TRUE;		// token starts at the segment root
+	BOOL prevkept = FALSE;	// previous token of the segment is kept and followed by a separator
+	INT tokens = 0;
+	INT tokpos = 0;
+	WCHAR ch;
+	for(; (ch = *in) != '\0'; in++) {
+		if (ch < 32)
+			ch = c.replacement;
+		else {
+			if ((tokpos == 0) && (ch == L' '))			// trim leading spaces
+				continue;
+			if (isnet && (tokens == 0) && (tokpos == 0) && (ch == '.'))
+				return FALSE;							// MSFT: (NetBIOS computer) Names can contain a period, but names cannot start with a period.
+			if (wcschr(L"<>:\"\\/|?*", ch)) {
+				if (ch == '\\') {
+					if ((in > str) && *(in - 1) == '\\')	// normalize separators
+						continue;
+					CanonTrim(c, tokstart, tokpos);
+					if ((c.out == tokstart) && !atroot)	// empty token
+						tokens--;
+					tokens++;
+					if (isnet && (tokens == 2)) {		// computer and share names are the root
+						if (!ownroot) {
+							if (c.out != tokstart)
+								CanonCommit(c, tokstart, !literal, TRUE);
+						} else {
+							if (c.out != tokstart)
+								*c.out++ = L'\\';
+							c.root = c.out;
+							c.tokens = 0;
+							literal = !collapse;
+						}
+						atroot = TRUE;
+						prevkept = FALSE;
+					} else if (c.out != tokstart) {
+						prevkept = CanonCommit(c, tokstart, !literal, TRUE);
+						atroot = FALSE;
+					} else {
+						if (literal && atroot)			// sanitizing leaves the separator there
+							*c.out++ = L'\\';
+						atroot = FALSE;
+					}
+					tokstart = c.out;
+					tokpos = 0;
+					continue;
+				}
+				if (isnet && (tokens == 0))
+					return FALSE;						// bad computer name
+				ch = c.replacement;
+			}
+		}
+		*c.out++ = ch;
+		tokpos++;
+	}
+	CanonTrim(c, tokstart, tokpos);
+	if (c.out != tokstart)
+		CanonCommit(c, tokstart, !literal, !last);
+	else if (literal) {
+		if (last && !atroot)
+			c.out--;									// trim trailing separator
+		else if (!last && atroot)
+			*c.out++ = L'\\';
+	} else if (last && !atroot && prevkept)
+		c.out--;										// trim trailing separator
+	if (collapse && literal)							// network path without a share
+		CanonCollapse(c);
+
+	return TRUE;
+}
+
+// path made absolute against reference (relative path is appended, one starting with '\' goes to reference root),
+// sanitized like SanitizeFileSystemString does and with . and .. collapsed, all in one pass over both
+// buf takes wcslen(reference) + wcslen(path) + 2 at most; returns the length, 0 for a bad path or a short buffer
+SIZE_T Utils::CanonicalPath( LPCWSTR path, LPCWSTR reference, LPWSTR buf, SIZE_T bufsz, PATHINFO * info, BOOL reflock, WCHAR replacement )
+{
+	SIZE_T reflen = wcslen(reference);
+	LPWSTR refend = NULL;
+	INT pref = ParsePath(reference, reflen, &refend);
+	if ((pref < 0) || IsPathRelative(pref))
+		return 0;
+
+	SIZE_T pathlen = wcslen(path);
+	LPWSTR pathend = NULL;
+	INT ppath = ParsePath(path, pathlen, &pathend);
+	BOOL relp = (ppath < 0) || IsPathRelative(ppath);
+	if (bufsz < (relp?reflen:0) + pathlen + 2) // + separator + \0
+		return 0;
+
+	canon_t c = { buf, buf, 0, replacement };
+	if (relp) {
+		if (!CanonSegment(c, reference, pref, refend, TRUE, !reflock, pathlen == 0))
+			return 0;
+		if (reflock) {
+			c.root = c.out;
+			c.tokens = 0;
+		}
+		if (*path == '\\') { // relative to root
+			c.out = c.root;
+			c.tokens = 0;
+			path++;
+			ppath = ParsePath(path, pathlen - 1, &pathend);
+		}
+		if (!CanonSegment(c, path, ppath, pathend, FALSE, TRUE, TRUE))
+			return 0;
+	} else if (!CanonSegment(c, path, ppath, pathend, TRUE, TRUE, TRUE))
+		return 0;
+	*c.out = '\0';
+
+	if (info != NULL) {
+		info->root = c.root - buf;
+		info->tokens = c.tokens;
+	}
+
+	return c.out - buf;
+}
+
+// '.' is the radix character whatever the locale is
+BOOL Utils::ParseDouble( LPCWSTR str, LPCWSTR & endptr, DOUBLE & val )
+{
+	return Numeric::ParseDouble(str, endptr, val) ? TRUE : FALSE;
+}
+
+double Utils::RadtoDeg(double Rad)
+{
+	return Rad / M_PI * 180.0;
+}
+
+double Utils::DegtoRad(double Deg)
+{
+    return Deg * M_PI / 180;
+}
+
+/* from iproute2 */
+INT Utils::Matches( LPCWSTR cmd, LPCWSTR pattern )
+{
+	size_t len = wcslen(cmd);
+	if (len > wcslen(pattern))
+		return -1;
+	return wmemcmp(pattern, cmd, len);
+}
+
+// from Notepad2
+/**
+ * If the character is an hexa digit, get its value.
+ */
+static INT GetHexDigit( WCHAR ch ) {
+	if (ch >= '0' && ch <= '9') {
+		return ch - '0';
+	}
+	if (ch >= 'A' && ch <= 'F') {
+		return ch - 'A' + 10;
+	}
+	if (ch >= 'a' && ch <= 'f') {
+		return ch - 'a' + 10;
+	}
+	return -1;
+}
+
+// what a character after a backslash stands for: the character itself (0),
+// a control character or minus the most hex digits of the code that follows
+static const signed char s_escapes[128] = {
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,	// @A-O
+	0,  0,  0,  0,  0, -8,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,	// P-_: \U
+	0,'\a','\b', 0,  0,  0,'\f', 0,  0,  0,  0,  0,  0,  0,'\n', 0,	// `a-o
+	0,  0,'\r', 0,'\t', -4,'\v', 0, -2,  0,  0,  0,  0,  0,  0,  0	// p-DEL: \u, \x
+};
+
+/**
+ * Convert C style \a, \b, \f, \n, \r, \t, \v, \xhh, \uhhhh and \Uhhhhhhhh into their indicated characters.
+ * Codes above U+FFFF become surrogate pairs where WCHAR is UTF-16, zero and
+ * out of range codes are dropped. Text between backslashes is moved in bulk.
+ */
+UINT Utils::UnSlash( LPWSTR s ) {
+	LPCWSTR end = s + wcslen(s);
+	LPCWSTR in = s;
+	LPWSTR o = s;
+
+	while (in < end) {
+		if (*in != '\\') {
+			// a few characters are copied as they are looked at, a longer run is scanned and moved in bulk
+			LPCWSTR runend = (end - in > 8) ? in + 8 : end;
+			while ((in < runend) && (*in != '\\'))
+				*o++ = *in++;
+			if ((in == runend) && (in < end)) {
+				LPCWSTR slash = Scan::Find(in, end, '\\');
+				if (o != in)
+					wmemmove(o, in, slash - in);
+				o += slash - in;
+				in = slash;
+			}
+			continue;
+		}
+		if (++in == end)	// lone trailing backslash
+			break;
+
+		WCHAR ch = *in++;
+		INT esc = ((UINT)ch < _countof(s_escapes)) ? s_escapes[ch] : 0;
+		if (esc == 0)
+			*o++ = ch;
+		else if (esc > 0)
+			*o++ = (WCHAR)esc;
+		else {
+			UINT val = 0;
+			INT hex;
+			for (INT digits = -esc; digits && (in < end) && ((hex = GetHexDigit(*in)) >= 0); digits--, in++)
+				val = val * 16 + hex;
+			if ((val == 0) || (val > 0x10FFFF))
+				continue;
+#if WCHAR_MAX <= 0xFFFF
+			if (val > 0xFFFF) {
+				val -= 0x10000;
+				*o++ = (WCHAR)(0xD800 + (val >> 10));
+				val = 0xDC00 + (val & 0x3FF);
+			}
+#endif
+			*o++ = (WCHAR)val;
+		}
+	}
+	*o = '\0';
+	return (UINT)(o - s);
+}